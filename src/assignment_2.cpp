@@ -1,9 +1,28 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
 #include "mygl/shader.h"
+#include "mygl/framebuffer.h"
+#include "mygl/capture.h"
+#include "mygl/recorder.h"
+#include "mygl/profiler.h"
+#include "mygl/headless.h"
 #include "mygl/model.h"
+#include "mygl/arena.h"
+#include "mygl/grid.h"
+#include "mygl/lightgrid.h"
+#include "mygl/renderqueue.h"
+#include "mygl/uniformbuffer.h"
+#include "mygl/glstate.h"
 #include "mygl/camera.h"
+#include "mygl/loader.h"
+#include "mygl/lod.h"
 
 #include "boat.h"
 #include "water.h"
@@ -12,6 +31,7 @@ struct DayLight {
     Vector3D directLight;
     Vector3D ambientLight;
     Vector3D position;
+    bool spotLights;    // spot lights are only visible (and evaluated) at night
 };
 struct SpotLight {
     Vector3D directLight;
@@ -23,10 +43,12 @@ struct SpotLight {
 // Saving these two is necessary for switching between day and night
 DayLight LIGHT_DAY{{1, 1, 1},
                    {0.6, 0.6, 0.6},
-                   {100, 300, 0}};
+                   {100, 300, 0},
+                   false};
 DayLight LIGHT_NIGHT{{0.25, 0.25, 0.3},
                      {0.1,  0.1,  0.2},
-                     {-100, 300,  0}};
+                     {-100, 300,  0},
+                     true};
 
 // These are the basic positions to which rotation and translation will be applied
 // Spotlight array: 0=HeadLightLeft, 1=HeadLightRight, 2=PositionLightLeft, 3=PositionLightRight
@@ -34,8 +56,53 @@ const Vector3D SPOT_LIGHT_POSITIONS[4] = {{-1, 2, -0.2}, {1, 2, -0.2}, {-1, 2, -
 const Vector3D SPOT_LIGHT_DIRECTIONS[4] = {{-1, 0, 20},{1, 0, 20},{-20, 2, -2},{20, 2, -2}};
 
 
+/* std140 layout of the FrameData uniform block in the shaders, vec3 members are padded to 16 bytes */
+struct FrameData {
+    float view[16];
+    float proj[16];
+    float cameraPosition[4];
+    float dayDirectLight[4];
+    float dayAmbientLight[4];
+    float dayPosition[4];
+    struct {
+        float directLight[4];
+        float position[4];
+        float direction[3];
+        float cosCutoff;
+    } spotLights[4];
+};
+static_assert(sizeof(FrameData) == 384, "FrameData has to match the std140 layout of the uniform block");
+
+const GLuint FRAME_DATA_BINDING = 0;
+
+/* render queue layers, the boats are drawn before the water they cover */
+enum eLayer { LAYER_BOATS = 0, LAYER_WATER = 1 };
+
 Vector3D BACKGROUND_COLOR = {80.0 / 255, 160.0 / 255, 240.0 / 255};
 
+// Number of boats floating around the controlled one, set with --fleet N
+unsigned int FLEET_SIZE = 0;
+const float FLEET_SPACING = 8.0f;
+
+// The water is a clipmap generated in the vertex shader around the camera, the resolution of its levels can be changed
+// at runtime with + and -, the number of levels follows so the water always reaches the far plane
+const unsigned int WATER_RESOLUTION = 64;
+const unsigned int WATER_MAX_RESOLUTION = 512;
+const float WATER_CELL_SIZE = 0.6225646f;
+
+// Draw boats and water into the depth buffer first and shade only the visible fragments (GL_EQUAL, no depth writes)
+// after it, set with --depth-prepass and toggled with Z
+bool DEPTH_PREPASS = false;
+
+// Every frame is recorded while R is toggled on (or from the start with --record PATH), as numbered PNG or QOI images
+// (a printf pattern) or a Y4M stream (PATH ends with .y4m)
+std::string RECORD_PATH = "recording/frame%06d.png";
+
+// CPU and GPU zones are always profiled, T prints their statistics and writes the trace to TRACE_PATH (also written on
+// exit if it is set with --trace PATH)
+std::string TRACE_PATH = "profile.json";
+bool TRACE_ON_EXIT = false;
+
 
 
 struct {
@@ -44,27 +111,188 @@ struct {
     float zoomSpeedMultiplier;
 
     Boat boat;
-    Model water;
-
-    ShaderProgram shaderBoat;
-    ShaderProgram shaderWater;
+    Clipmap water;
+    Material waterMaterial;
+    unsigned int waterBlocks = 0;
+
+    /* boats drawn instanced with the parts of the controlled boat */
+    std::vector<Boat> fleet;
+    Bounds boatBounds;
+
+    /* programs are specialized for the number of active spot lights */
+    ShaderVariants shaderBoat;
+    ShaderVariants shaderWater;
+    /* depth only programs of the pre-pass */
+    ShaderVariants shaderBoatDepth;
+    ShaderVariants shaderWaterDepth;
+    UniformBuffer frameData;
 
     DayLight lightDayNight;
     SpotLight spotLights[4];
+    int activeSpotLights;
+
+    /* lights of all boats, used instead of spotLights once there are more than the uniform block holds */
+    LightGrid lightGrid;
+    bool clustered = false;
 
     WaterSim waterSim;
+
+    /* static meshes share the buffers of one arena, all draws go through the sorted render queue */
+    MeshArena arena;
+    RenderQueue queue;
+
+    /* boats are instanced, each part is pushed once per level of detail for all boats that use the level */
+    InstanceBuffer boatInstances;
+    std::size_t boatsDrawn = 0;
+    std::size_t boatsCulled = 0;
+
+    /* the boat is streamed in while the first frames are already rendered */
+    AssetLoader loader;
+    std::shared_ptr<ModelAsset> boatAsset;
+
+    /* frames are read back asynchronously and encoded on background threads */
+    Capture capture;
+    std::shared_ptr<CaptureJob> screenshot;
+    Recorder recorder;
+    bool recording = false;
 } sScene;
 
+/* --headless renders a fixed number of frames into a framebuffer without window, e.g. on servers without X. The scene
+   advances by frameTime per frame, the camera follows the keyframes of the camera path from the first to the last frame
+   and every frame is recorded to output (see RECORD_PATH, e.g. frame%05d.png or frames.y4m) if it is set. */
+struct {
+    bool enabled = false;
+    unsigned int width = 1280;
+    unsigned int height = 720;
+    unsigned int frames = 100;
+    float frameTime = 1.0f / 30.0f;
+    std::string cameraPath;
+    std::string output;
+} sHeadless;
+
 struct {
     bool mouseButtonPressed = false;
     Vector2D mousePressStart;
     bool keyPressed[Boat::eControl::CONTROL_COUNT] = {false, false, false, false};
+    bool screenshot = false;
 } sInput;
 
 void updateLights() {
     for (int i=0;i<4;i++){
         sScene.spotLights[i].position=sScene.boat.transformation * Vector4D(SPOT_LIGHT_POSITIONS[i]);
-        sScene.spotLights[i].direction=sScene.boat.transformation * Vector4D(SPOT_LIGHT_DIRECTIONS[i]);
+        sScene.spotLights[i].direction=sScene.boat.transformation * Vector4D(SPOT_LIGHT_DIRECTIONS[i], 0.0f);
+    }
+}
+
+/* collect the lights of all boats, the fleet carries the same lights as the controlled boat */
+void updateLightGrid() {
+    lightGridClear(sScene.lightGrid);
+
+    std::vector<const Boat *> boats = {&sScene.boat};
+    for (const auto &boat: sScene.fleet) {
+        boats.push_back(&boat);
+    }
+
+    for (const Boat *boat: boats) {
+        for (int i = 0; i < 4; i++) {
+            const SpotLight &spot = sScene.spotLights[i];
+            Light light;
+            light.color = spot.directLight;
+            light.position = boat->transformation * Vector4D(SPOT_LIGHT_POSITIONS[i]);
+            light.direction = boat->transformation * Vector4D(SPOT_LIGHT_DIRECTIONS[i], 0.0f);
+            light.cosCutoff = std::cos(spot.cutoffAngle);
+            light.range = lightRange(spot.directLight);
+            lightGridAdd(sScene.lightGrid, light);
+        }
+    }
+
+    sScene.clustered = sScene.lightGrid.lights.size() > 4;
+}
+
+void copyVector(float *out, const Vector3D &v) {
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+}
+
+/* write camera and lights into the per frame uniform buffer that all programs read */
+void updateFrameData(const Matrix4D &view, const Matrix4D &proj) {
+    FrameData data = {};
+    std::memcpy(data.view, view.ptr(), sizeof(data.view));
+    std::memcpy(data.proj, proj.ptr(), sizeof(data.proj));
+    copyVector(data.cameraPosition, sScene.camera.position);
+
+    copyVector(data.dayDirectLight, sScene.lightDayNight.directLight);
+    copyVector(data.dayAmbientLight, sScene.lightDayNight.ambientLight);
+    copyVector(data.dayPosition, sScene.lightDayNight.position);
+
+    /* lights without color contribute nothing, the active ones are packed to the front and counted */
+    sScene.activeSpotLights = 0;
+    for (const auto &light: sScene.spotLights) {
+        if (light.directLight.x <= 0.0f && light.directLight.y <= 0.0f && light.directLight.z <= 0.0f) {
+            continue;
+        }
+        auto &out = data.spotLights[sScene.activeSpotLights++];
+        copyVector(out.directLight, light.directLight);
+        copyVector(out.position, light.position);
+        copyVector(out.direction, light.direction);
+        out.cosCutoff = std::cos(light.cutoffAngle);
+    }
+
+    uniformBufferUpdate(sScene.frameData, &data);
+}
+
+/* defines of the cheapest program variant for the current lights, in daylight no spot light is evaluated */
+std::vector<std::string> shaderDefines() {
+    if (!sScene.lightDayNight.spotLights) {
+        return {"DAY"};
+    }
+    if (sScene.clustered) {
+        return {"CLUSTERED"};
+    }
+    return {"SPOT_LIGHTS " + std::to_string(sScene.activeSpotLights)};
+}
+
+/* set the resolution of the water levels and add levels until the water reaches the far plane */
+void waterResize(unsigned int resolution) {
+    unsigned int levels = 1;
+    clipmapResize(sScene.water, resolution, levels);
+    while (clipmapExtent(sScene.water) < sScene.camera.farPlane) {
+        clipmapResize(sScene.water, resolution, ++levels);
+    }
+}
+
+/* recording has a fixed frame size, it is stopped when the window is resized */
+void recordStart(unsigned int width, unsigned int height, float fps) {
+    try {
+        sScene.recorder = recorderCreate(RECORD_PATH, width, height, fps);
+        sScene.recording = true;
+        std::cout << "Recording to " << RECORD_PATH << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void recordStop() {
+    if (!sScene.recording) {
+        return;
+    }
+
+    std::uint64_t frames = sScene.recorder.frames;
+    std::size_t stalls = sScene.recorder.capture.stalls;
+    recorderDelete(sScene.recorder);
+    sScene.recording = false;
+    std::cout << "Recorded " << frames << " frames, waited " << stalls << " times for the encoders" << std::endl;
+}
+
+/* rolling statistics of all zones, nested zones are indented below their parent */
+void printProfile() {
+    std::cout << "zone (mean / min / max ms over the last " << profileWindow << " occurrences)" << std::endl;
+    for (const auto &zone: profilerStats()) {
+        std::size_t depth = std::count(zone.path.begin(), zone.path.end(), '/');
+        std::size_t name = zone.path.rfind('/');
+        std::cout << std::string(2 * depth, ' ') << (name == std::string::npos ? zone.path : zone.path.substr(name + 1))
+                  << (zone.gpu ? " [GPU]: " : ": ") << zone.mean << " / " << zone.min << " / " << zone.max << std::endl;
     }
 }
 
@@ -111,9 +339,51 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
         glfwSetWindowShouldClose(window, true);
     }
 
-    /* make screenshot and save in work directory */
+    /* print how many GL calls the state cache issued and skipped and how many items were culled in the last frame */
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        StateCounters counters = stateCounters();
+        std::cout << "binds: " << counters.binds << " issued, " << counters.bindsSkipped << " skipped; "
+                  << "uniforms: " << counters.uniforms << " issued, " << counters.uniformsSkipped << " skipped; "
+                  << "items: " << sScene.queue.drawn << " drawn, " << sScene.queue.culled << " culled; "
+                  << "boats: " << sScene.boatsDrawn << " drawn, " << sScene.boatsCulled << " culled; "
+                  << "water: " << sScene.waterBlocks << " blocks, " << sScene.water.levels << " levels; "
+                  << "lights: " << sScene.lightGrid.lights.size() << (sScene.clustered ? " clustered, " : ", ")
+                  << sScene.lightGrid.indices.size() << " cluster entries" << std::endl;
+    }
+
+    /* depth pre-pass */
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS) {
+        DEPTH_PREPASS = !DEPTH_PREPASS;
+    }
+
+    /* water resolution */
+    if ((key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD) && action == GLFW_PRESS) {
+        waterResize(std::min(2 * sScene.water.resolution, WATER_MAX_RESOLUTION));
+    }
+    if ((key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT) && action == GLFW_PRESS) {
+        waterResize(sScene.water.resolution / 2);
+    }
+
+    /* profile */
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        printProfile();
+        if (profilerWriteTrace(TRACE_PATH)) {
+            std::cout << "Saved " << TRACE_PATH << std::endl;
+        }
+    }
+
+    /* record every frame */
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        if (sScene.recording) {
+            recordStop();
+        } else {
+            recordStart(sScene.camera.width, sScene.camera.height, 60.0f);
+        }
+    }
+
+    /* make screenshot of the next frame and save in work directory */
     if (key == GLFW_KEY_P && action == GLFW_PRESS) {
-        screenshotToPNG("screenshot.png");
+        sInput.screenshot = true;
     }
 }
 
@@ -140,6 +410,9 @@ void mouseScrollCallback(GLFWwindow *window, double xoffset, double yoffset) {
 }
 
 void windowResizeCallback(GLFWwindow *window, int width, int height) {
+    if (sScene.recording && (width != int(sScene.recorder.width) || height != int(sScene.recorder.height))) {
+        recordStop();
+    }
     glViewport(0, 0, width, height);
     sScene.camera.width = width;
     sScene.camera.height = height;
@@ -150,11 +423,31 @@ void sceneInit(float width, float height) {
     sScene.cameraFollowBoat = true;
     sScene.zoomSpeedMultiplier = 0.05f;
 
-    sScene.boat = boatLoad("../assets/boat/boat.obj");
-    sScene.water = modelLoad("../assets/water/water.obj").front();
+    /* the shaders compute their normals from the waves, the vertices don't need one (12 bytes per vertex) */
+    sScene.arena = meshArenaCreate(VertexCompact | VertexNoNormal | VertexPositionStream);
+    sScene.queue = renderQueueCreate();
+    sScene.boatInstances = instanceBufferCreate();
+    sScene.lightGrid = lightGridCreate();
+    sScene.fleet = boatFleetCreate(FLEET_SIZE, FLEET_SPACING);
+
+    sScene.loader = assetLoaderCreate();
+    sScene.capture = captureCreate();
+    sScene.boatAsset = assetLoadModel(sScene.loader, "../assets/boat/boat.obj", {.optimize = true, .lodLevels = 3, .arena = &sScene.arena});
+
+    sScene.water = clipmapCreate(WATER_RESOLUTION, 1, WATER_CELL_SIZE);
+    waterResize(WATER_RESOLUTION);
+    sScene.waterMaterial = materialLoad("../assets/water/water.mtl").at("water");
 
-    sScene.shaderBoat = shaderLoad("shader/default.vert", "shader/color.frag");
-    sScene.shaderWater = shaderLoad("shader/default.vert", "shader/color.frag");
+    sScene.shaderBoat = shaderVariantsLoad("shader/default.vert", "shader/color.frag");
+    sScene.shaderWater = shaderVariantsLoad("shader/default.vert", "shader/color.frag");
+    sScene.shaderBoatDepth = shaderVariantsLoad("shader/default.vert", "shader/depth.frag");
+    sScene.shaderWaterDepth = shaderVariantsLoad("shader/default.vert", "shader/depth.frag");
+
+    sScene.frameData = uniformBufferCreate(FRAME_DATA_BINDING, sizeof(FrameData));
+    shaderVariantsUniformBlock(sScene.shaderBoat, "FrameData", FRAME_DATA_BINDING);
+    shaderVariantsUniformBlock(sScene.shaderWater, "FrameData", FRAME_DATA_BINDING);
+    shaderVariantsUniformBlock(sScene.shaderBoatDepth, "FrameData", FRAME_DATA_BINDING);
+    shaderVariantsUniformBlock(sScene.shaderWaterDepth, "FrameData", FRAME_DATA_BINDING);
 
     // Light
     sScene.lightDayNight = LIGHT_DAY;
@@ -166,10 +459,47 @@ void sceneInit(float width, float height) {
 }
 
 
+void sceneDelete() {
+    recordStop();
+    captureDelete(sScene.capture);
+    assetLoaderDelete(sScene.loader);
+    boatDelete(sScene.boat);
+    clipmapDelete(sScene.water);
+    renderQueueDelete(sScene.queue);
+    instanceBufferDelete(sScene.boatInstances);
+    lightGridDelete(sScene.lightGrid);
+    meshArenaDelete(sScene.arena);
+    shaderVariantsDelete(sScene.shaderBoat);
+    shaderVariantsDelete(sScene.shaderWater);
+    shaderVariantsDelete(sScene.shaderBoatDepth);
+    shaderVariantsDelete(sScene.shaderWaterDepth);
+    uniformBufferDelete(sScene.frameData);
+}
+
+void sceneStreamAssets() {
+    assetLoaderUpdate(sScene.loader);
+
+    /* take over streamed assets as soon as they are completely uploaded */
+    if (sScene.boatAsset && sScene.boatAsset->state == AssetFailed) {
+        throw std::runtime_error(sScene.boatAsset->error);
+    }
+
+    if (sScene.boatAsset && sScene.boatAsset->state == AssetReady) {
+        sScene.boat.partModel = std::move(sScene.boatAsset->models);
+        sScene.boatBounds = boatBounds(sScene.boat);
+        sScene.boatAsset.reset();
+    }
+}
+
 void sceneUpdate(float dt) {
+    PROFILE_ZONE("sceneUpdate");
+
     sScene.waterSim.accumTime += dt;
 
+    sceneStreamAssets();
+
     boatMove(sScene.boat, sScene.waterSim, sInput.keyPressed, dt);
+    boatFleetMove(sScene.fleet, sScene.waterSim, dt);
 
     // Pass time to the water shader
 //    glUseProgram(sScene.shaderWater.id);
@@ -182,94 +512,171 @@ void sceneUpdate(float dt) {
         cameraFollow(sScene.camera, sScene.boat.position);
 }
 
+/* push the controlled boat and the fleet: boats outside the frustum are culled by their bounding sphere, the visible
+   ones are grouped by the level of detail each part needs, so every part, level and material is one instanced item.
+   The queue culls these items by the bounds of the material around all of their instances. */
+void pushBoats(ShaderProgram &shader, ShaderProgram *depthShader) {
+    sScene.boatsDrawn = 0;
+    sScene.boatsCulled = 0;
+    instanceBufferClear(sScene.boatInstances);
+    if (sScene.boat.partModel.empty()) {
+        return;
+    }
+
+    const Frustum &frustum = sScene.queue.frustum;
+    std::vector<const Boat *> boats = {&sScene.boat};
+    for (const auto &boat: sScene.fleet) {
+        boats.push_back(&boat);
+    }
+
+    std::vector<float> x(boats.size()), y(boats.size()), z(boats.size()), radius(boats.size());
+    for (std::size_t i = 0; i < boats.size(); i++) {
+        Bounds world = boundsTransform(sScene.boatBounds, boats[i]->transformation);
+        x[i] = world.center.x;
+        y[i] = world.center.y;
+        z[i] = world.center.z;
+        radius[i] = world.radius;
+    }
+
+    std::vector<std::uint8_t> visible(boats.size());
+    sScene.boatsDrawn = frustumCullSpheres(frustum, x.data(), y.data(), z.data(), radius.data(), boats.size(), visible.data());
+    sScene.boatsCulled = boats.size() - sScene.boatsDrawn;
+
+    std::vector<const Boat *> visibleBoats;
+    for (std::size_t i = 0; i < boats.size(); i++) {
+        if (visible[i]) {
+            visibleBoats.push_back(boats[i]);
+        }
+    }
+
+    std::vector<unsigned int> levels(visibleBoats.size());
+    for (const auto &model: sScene.boat.partModel) {
+        for (std::size_t i = 0; i < visibleBoats.size(); i++) {
+            levels[i] = modelSelectLod(model, sScene.camera, visibleBoats[i]->transformation);
+        }
+
+        /* boats using the same level get a contiguous range of instances */
+        for (unsigned int level = 0; level <= model.lod.size(); level++) {
+            unsigned int first = instanceBufferCount(sScene.boatInstances);
+            for (std::size_t i = 0; i < visibleBoats.size(); i++) {
+                if (levels[i] == level) {
+                    instanceBufferAdd(sScene.boatInstances, visibleBoats[i]->transformation, visibleBoats[i]->tint);
+                }
+            }
+
+            unsigned int count = instanceBufferCount(sScene.boatInstances) - first;
+            if (count == 0) {
+                continue;
+            }
+
+            for (const auto &material: modelLodMaterial(model, level)) {
+                Bounds bounds;
+                bool empty = true;
+                for (std::size_t i = 0; i < visibleBoats.size(); i++) {
+                    if (levels[i] == level) {
+                        Bounds world = boundsTransform(material.bounds, visibleBoats[i]->transformation);
+                        bounds = empty ? world : boundsMerge(bounds, world);
+                        empty = false;
+                    }
+                }
+                renderQueuePushInstanced(sScene.queue, shader, model.mesh, material, Matrix4D::identity(),
+                                         sScene.boatInstances, first, count, bounds, depthShader, LAYER_BOATS);
+            }
+        }
+    }
+}
+
+/* water levels around the camera without vertex data, the waves displace them vertically by up to the sum of their
+   amplitudes */
+void pushWater(ShaderProgram &shader, ShaderProgram *depthShader) {
+    float displacement = 0.0f;
+    for (const auto &wave: sScene.waterSim.parameter) {
+        displacement += std::abs(wave.amplitude);
+    }
+    clipmapUpdate(sScene.water, sScene.camera.position);
+    sScene.waterBlocks = clipmapPush(sScene.queue, sScene.water, sScene.waterMaterial, shader, displacement, depthShader, LAYER_WATER);
+}
+
+/* uniforms shared by all water blocks, the queue draws them with the program that is set up here */
+void waterUniforms(ShaderProgram &shader) {
+    stateUseProgram(shader.id);
+    shaderUniform(shader, "wave1Params", sScene.waterSim.parameter[0]);
+    shaderUniform(shader, "wave2Params", sScene.waterSim.parameter[1]);
+    shaderUniform(shader, "wave3Params", sScene.waterSim.parameter[2]);
+    shaderUniform(shader, "uTime", sScene.waterSim.accumTime);
+    shaderUniform(shader, "uGridMorph", clipmapMorph(sScene.water));
+}
+
 void render() {
+    PROFILE_ZONE("render");
+
     /* setup camera and model matrices */
     Matrix4D proj = cameraProjection(sScene.camera);
     Matrix4D view = cameraView(sScene.camera);
-    glUseProgram(sScene.shaderBoat.id);
-    shaderUniform(sScene.shaderBoat, "uProj", proj);
-    shaderUniform(sScene.shaderBoat, "uView", view);
-    shaderUniform(sScene.shaderBoat, "uModel", sScene.boat.transformation);
-
-    for (unsigned int i = 0; i < sScene.boat.partModel.size(); i++) {
-        auto &model = sScene.boat.partModel[i];
-        glBindVertexArray(model.mesh.vao);
-
-        shaderUniform(sScene.shaderBoat, "uModel", sScene.boat.transformation);
-
-        for (auto &material: model.material) {
-            /* set material properties */
-            shaderUniform(sScene.shaderBoat, "uMaterial.ambient", material.ambient);
-            shaderUniform(sScene.shaderBoat, "uMaterial.diffuse", material.diffuse);
-            shaderUniform(sScene.shaderBoat, "uMaterial.specular", material.specular);
-            shaderUniform(sScene.shaderBoat, "uMaterial.shininess", material.shininess);
-            shaderUniform(sScene.shaderBoat, "uCamera.position", sScene.camera.position);
-
-            shaderUniform(sScene.shaderBoat, "uLightDayNight.directLight", sScene.lightDayNight.directLight);
-            shaderUniform(sScene.shaderBoat, "uLightDayNight.ambientLight", sScene.lightDayNight.ambientLight);
-            shaderUniform(sScene.shaderBoat, "uLightDayNight.position", sScene.lightDayNight.position);
-
-            for(int u=0;u<4;u++){
-                shaderUniform(sScene.shaderBoat, "uSpotLights["+std::to_string(u)+"].directLight", sScene.spotLights[u].directLight);
-                shaderUniform(sScene.shaderBoat, "uSpotLights["+std::to_string(u)+"].position", sScene.spotLights[u].position);
-                shaderUniform(sScene.shaderBoat, "uSpotLights["+std::to_string(u)+"].direction", sScene.spotLights[u].direction);
-                shaderUniform(sScene.shaderBoat, "uSpotLights["+std::to_string(u)+"].cutoffAngle", sScene.spotLights[u].cutoffAngle);
-            }
-
-
+    updateFrameData(view, proj);
+    updateLightGrid();
+
+    /* variants are compiled on first use, switching lights on or off later only changes the program */
+    std::vector<std::string> defines = shaderDefines();
+    std::vector<std::string> waterDefines = defines;
+    waterDefines.insert(waterDefines.end(), {"GRID", "CLIPMAP"});
+    defines.push_back("INSTANCED");
+    ShaderProgram &shaderBoat = shaderVariant(sScene.shaderBoat, defines);
+    ShaderProgram &shaderWater = shaderVariant(sScene.shaderWater, waterDefines);
+
+    /* the pre-pass only writes depth, the boats read just their positions */
+    ShaderProgram *shaderBoatDepth = nullptr;
+    ShaderProgram *shaderWaterDepth = nullptr;
+    if (DEPTH_PREPASS) {
+        shaderBoatDepth = &shaderVariant(sScene.shaderBoatDepth, {"INSTANCED"});
+        shaderWaterDepth = &shaderVariant(sScene.shaderWaterDepth, {"GRID", "CLIPMAP"});
+    }
 
-            glDrawElements(GL_TRIANGLES, material.indexCount, GL_UNSIGNED_INT,
-                           (const void *) (material.indexOffset * sizeof(unsigned int)));
+    /* many lights are binned into clusters, so every fragment only evaluates the lights close to it */
+    if (sScene.clustered && sScene.lightDayNight.spotLights) {
+        PROFILE_ZONE("lightGridBuild");
+        lightGridBuild(sScene.lightGrid, sScene.camera);
+        for (ShaderProgram *shader: {&shaderBoat, &shaderWater}) {
+            stateUseProgram(shader->id);
+            lightGridBind(sScene.lightGrid, *shader);
         }
     }
 
-    /* render water */
     {
-        glUseProgram(sScene.shaderWater.id);
-
-        /* setup camera and model matrices */
-        shaderUniform(sScene.shaderWater, "uProj", proj);
-        shaderUniform(sScene.shaderWater, "uView", view);
-        shaderUniform(sScene.shaderWater, "uModel", Matrix4D::identity());
-        shaderUniform(sScene.shaderWater, "wave1Params", sScene.waterSim.parameter[0]);
-        shaderUniform(sScene.shaderWater, "wave2Params", sScene.waterSim.parameter[1]);
-        shaderUniform(sScene.shaderWater, "wave3Params", sScene.waterSim.parameter[2]);
-        // print parameters
-        std::cout << "wave1Params: " << sScene.waterSim.parameter[0].amplitude << ", " << sScene.waterSim.parameter[0].phi << ", " << sScene.waterSim.parameter[0].omega << std::endl;
-        std::cout << "wave1Params direction: " << sScene.waterSim.parameter[0].direction.x << ", " << sScene.waterSim.parameter[0].direction.y << std::endl;
-
-
-        shaderUniform(sScene.shaderWater, "uTime", sScene.waterSim.accumTime);
-
-        /* set material properties */
-        shaderUniform(sScene.shaderWater, "uMaterial.ambient", sScene.water.material.front().ambient);
-        shaderUniform(sScene.shaderWater, "uMaterial.diffuse", sScene.water.material.front().diffuse);
-        shaderUniform(sScene.shaderWater, "uMaterial.specular", sScene.water.material.front().specular);
-        shaderUniform(sScene.shaderWater, "uMaterial.shininess", sScene.water.material.front().shininess);
-        shaderUniform(sScene.shaderWater, "uCamera.position", sScene.camera.position);
-
-        shaderUniform(sScene.shaderWater, "uLightDayNight.ambientLight", sScene.lightDayNight.ambientLight);
-        shaderUniform(sScene.shaderWater, "uLightDayNight.directLight", sScene.lightDayNight.directLight);
-        shaderUniform(sScene.shaderWater, "uLightDayNight.position", sScene.lightDayNight.position);
-
-        for(int u=0;u<4;u++){
-            shaderUniform(sScene.shaderWater, "uSpotLights["+std::to_string(u)+"].directLight", sScene.spotLights[u].directLight);
-            shaderUniform(sScene.shaderWater, "uSpotLights["+std::to_string(u)+"].position", sScene.spotLights[u].position);
-            shaderUniform(sScene.shaderWater, "uSpotLights["+std::to_string(u)+"].direction", sScene.spotLights[u].direction);
-            shaderUniform(sScene.shaderWater, "uSpotLights["+std::to_string(u)+"].cutoffAngle", sScene.spotLights[u].cutoffAngle);
+        PROFILE_ZONE("prepare");
+        renderQueueBegin(sScene.queue, sScene.camera);
+        pushBoats(shaderBoat, shaderBoatDepth);
+        pushWater(shaderWater, shaderWaterDepth);
+        waterUniforms(shaderWater);
+        if (shaderWaterDepth) {
+            waterUniforms(*shaderWaterDepth);
         }
-        glBindVertexArray(sScene.water.mesh.vao);
-        glDrawElements(GL_TRIANGLES, sScene.water.material.front().indexCount, GL_UNSIGNED_INT,
-                       (const void *) (sScene.water.material.front().indexOffset * sizeof(unsigned int)));
     }
 
-    /* cleanup opengl state */
-    glBindVertexArray(0);
-    glUseProgram(0);
+    /* the pre-pass fills the depth buffer, the shading pass then runs the expensive fragment shader once per pixel, for
+       the nearest fragment only */
+    if (DEPTH_PREPASS) {
+        PROFILE_ZONE("depthPrepass");
+        PROFILE_GPU_ZONE("depthPrepass");
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        renderQueueSubmit(sScene.queue, true);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    renderQueueSubmit(sScene.queue);
+
+    /* the depth buffer has to be writable for the clear of the next frame */
+    if (DEPTH_PREPASS) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
 }
 
 
 void sceneDraw() {
+    PROFILE_GPU_ZONE("frame");
     glClearColor(BACKGROUND_COLOR.x * sScene.lightDayNight.ambientLight.x,
                  BACKGROUND_COLOR.y * sScene.lightDayNight.ambientLight.y,
                  BACKGROUND_COLOR.z * sScene.lightDayNight.ambientLight.z, 1.0);
@@ -278,12 +685,124 @@ void sceneDraw() {
     /*------------ render scene -------------*/
     render();
 
-    /* cleanup opengl state */
-    glBindVertexArray(0);
-    glUseProgram(0);
+    /* program and VAO stay bound into the next frame, the state cache skips binding them again */
+    stateNewFrame();
+}
+
+/* render the frames of sHeadless into a framebuffer, the frame rate printed at the end includes writing all images */
+int runHeadless() {
+    HeadlessContext context = headlessCreate();
+    if (!context.context) { return EXIT_FAILURE; }
+
+    stateEnable(GL_DEPTH_TEST);
+    sceneInit(sHeadless.width, sHeadless.height);
+
+    Framebuffer framebuffer = framebufferCreate(sHeadless.width, sHeadless.height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+    glViewport(0, 0, sHeadless.width, sHeadless.height);
+
+    std::vector<CameraKey> cameraPath;
+    if (!sHeadless.cameraPath.empty()) {
+        cameraPath = cameraPathLoad(sHeadless.cameraPath);
+    }
+
+    /* every frame has to show the complete scene, so the assets are loaded before the first one instead of streamed */
+    assetLoaderFinish(sScene.loader);
+    sceneStreamAssets();
+
+    if (!sHeadless.output.empty()) {
+        RECORD_PATH = sHeadless.output;
+        recordStart(sHeadless.width, sHeadless.height, 1.0f / sHeadless.frameTime);
+        if (!sScene.recording) {
+            framebufferDelete(framebuffer);
+            sceneDelete();
+            headlessDelete(context);
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 0; frame < sHeadless.frames; frame++) {
+        profilerNewFrame();
+        PROFILE_ZONE("frame");
+
+        sceneUpdate(sHeadless.frameTime);
+        cameraPathApply(sScene.camera, cameraPath, sHeadless.frames > 1 ? float(frame) / float(sHeadless.frames - 1) : 0.0f);
+
+        sceneDraw();
+
+        if (sScene.recording) {
+            recorderFrame(sScene.recorder, framebuffer.fbo, GL_COLOR_ATTACHMENT0, frame * sHeadless.frameTime);
+            recorderUpdate(sScene.recorder);
+        }
+    }
+    recordStop();
+    glFinish();
+
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << sHeadless.frames << " frames (" << sHeadless.width << "x" << sHeadless.height << ") in " << seconds.count()
+              << " s, " << sHeadless.frames / seconds.count() << " fps" << std::endl;
+
+    if (TRACE_ON_EXIT) {
+        profilerNewFrame();
+        printProfile();
+        profilerWriteTrace(TRACE_PATH);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    framebufferDelete(framebuffer);
+    sceneDelete();
+    profilerDelete();
+    headlessDelete(context);
+
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, char **argv) {
+    /*---------- command line ------------*/
+    bool record = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--fleet") == 0 && i + 1 < argc) {
+            FLEET_SIZE = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        if (std::strcmp(argv[i], "--depth-prepass") == 0) {
+            DEPTH_PREPASS = true;
+        }
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            sHeadless.enabled = true;
+        }
+        if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%ux%u", &sHeadless.width, &sHeadless.height) != 2 || sHeadless.width == 0 || sHeadless.height == 0) {
+                std::cerr << "--size expects WIDTHxHEIGHT" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            sHeadless.frames = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            sHeadless.frameTime = 1.0f / std::max(std::strtof(argv[++i], nullptr), 1.0f);
+        }
+        if (std::strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc) {
+            sHeadless.cameraPath = argv[++i];
+        }
+        if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            sHeadless.output = argv[++i];
+        }
+        if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            TRACE_PATH = argv[++i];
+            TRACE_ON_EXIT = true;
+        }
+        if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            RECORD_PATH = argv[++i];
+            record = true;
+        }
+    }
+
+    if (sHeadless.enabled) {
+        return runHeadless();
+    }
+
     /*---------- init window ------------*/
     int width = 1280;
     int height = 720;
@@ -298,15 +817,21 @@ int main(int argc, char **argv) {
     glfwSetFramebufferSizeCallback(window, windowResizeCallback);
 
     /*---------- init opengl stuff ------------*/
-    glEnable(GL_DEPTH_TEST);
+    stateEnable(GL_DEPTH_TEST);
 
     /* setup scene */
     sceneInit(width, height);
+    if (record) {
+        recordStart(width, height, 60.0f);
+    }
 
     /*-------------- main loop ----------------*/
     double timeStamp = glfwGetTime();
     double timeStampNew = 0.0;
     while (!glfwWindowShouldClose(window)) {
+        profilerNewFrame();
+        PROFILE_ZONE("frame");
+
         /* poll and process input and window events */
         glfwPollEvents();
 
@@ -318,16 +843,34 @@ int main(int argc, char **argv) {
         /* draw all objects in the scene */
         sceneDraw();
 
+        /* read the frame before it is presented, the image is written a few frames later */
+        if (sInput.screenshot) {
+            sScene.screenshot = captureRead(sScene.capture, 0, GL_BACK, sScene.camera.width, sScene.camera.height, "screenshot.png");
+            sInput.screenshot = false;
+        }
+        captureUpdate(sScene.capture);
+        if (sScene.recording) {
+            recorderFrame(sScene.recorder, 0, GL_BACK, timeStampNew);
+            recorderUpdate(sScene.recorder);
+        }
+        if (sScene.screenshot && (sScene.screenshot->state == CaptureDone || sScene.screenshot->state == CaptureFailed)) {
+            if (sScene.screenshot->state == CaptureDone) {
+                std::cout << "Saved " << sScene.screenshot->path << std::endl;
+            }
+            sScene.screenshot.reset();
+        }
+
         /* swap front and back buffer */
         glfwSwapBuffers(window);
     }
 
 
     /*-------- cleanup --------*/
-    boatDelete(sScene.boat);
-    modelDelete(sScene.water);
-    shaderDelete(sScene.shaderBoat);
-    shaderDelete(sScene.shaderWater);
+    if (TRACE_ON_EXIT) {
+        profilerWriteTrace(TRACE_PATH);
+    }
+    sceneDelete();
+    profilerDelete();
     windowDelete(window);
 
     return EXIT_SUCCESS;
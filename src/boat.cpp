@@ -1,5 +1,9 @@
 #include "boat.h"
 
+#include "mygl/profiler.h"
+
+#include <cmath>
+
 Boat boatLoad(const std::string& filepath)
 {
     Boat boat;
@@ -19,6 +23,8 @@ void boatDelete(Boat& boat)
 
 void boatMove(Boat& boat, const WaterSim& waterSim, bool control[], float dt)
 {
+    PROFILE_ZONE("boatMove");
+
     /* retrieve input for controls */
     float throttle = + control[Boat::eControl::THROTTLE_UP] - control[Boat::eControl::THROTTLE_DOWN];
     float rudder = + control[Boat::eControl::RUDDER_LEFT] - control[Boat::eControl::RUDDER_RIGHT];
@@ -45,3 +51,58 @@ void boatMove(Boat& boat, const WaterSim& waterSim, bool control[], float dt)
 
     boat.transformation = Matrix4D::translation(boat.position) * water_orientation;
 }
+
+Bounds boatBounds(const Boat& boat)
+{
+    Bounds bounds;
+    for(std::size_t i = 0; i < boat.partModel.size(); i++)
+    {
+        bounds = i == 0 ? boat.partModel[i].bounds : boundsMerge(bounds, boat.partModel[i].bounds);
+    }
+    return bounds;
+}
+
+std::vector<Boat> boatFleetCreate(unsigned int count, float spacing)
+{
+    std::vector<Boat> fleet(count);
+
+    /* square grid, the center cell is left free for the controlled boat */
+    unsigned int side = 1;
+    while(side * side < count + 1)
+    {
+        side += 2;
+    }
+
+    unsigned int cell = 0;
+    for(auto& boat : fleet)
+    {
+        if(cell == side * side / 2)
+        {
+            cell++;
+        }
+
+        float x = (float(cell % side) - float(side / 2)) * spacing;
+        float z = (float(cell / side) - float(side / 2)) * spacing;
+        boat.position = {x, 0.0, z};
+        boat.angles.y = std::fmod(0.7f * float(cell), 2.0f * float(M_PI));
+
+        /* pastel colors, spread over the hue circle by the golden angle */
+        float hue = std::fmod(2.39996f * float(cell), 2.0f * float(M_PI));
+        boat.tint = Vector4D(0.75f + 0.25f * std::cos(hue), 0.75f + 0.25f * std::cos(hue + 2.094f), 0.75f + 0.25f * std::cos(hue + 4.189f), 1.0f);
+
+        cell++;
+    }
+
+    return fleet;
+}
+
+void boatFleetMove(std::vector<Boat>& fleet, const WaterSim& waterSim, float dt)
+{
+    PROFILE_ZONE("boatFleetMove");
+
+    bool control[Boat::eControl::CONTROL_COUNT] = {false, false, false, false};
+    for(auto& boat : fleet)
+    {
+        boatMove(boat, waterSim, control, dt);
+    }
+}
@@ -22,8 +22,20 @@ struct Boat
     Matrix4D transformation = Matrix4D::identity();
     Vector3D position = {0.0, 0.0, 0.0};
     Vector3D angles = {0.0, 0.0, 0.0};
+
+    /* color the lighting of the boat is multiplied with when it is drawn instanced */
+    Vector4D tint = {1.0, 1.0, 1.0, 1.0};
 };
 
 Boat boatLoad(const std::string& filepath);
 void boatDelete(Boat& boat);
 void boatMove(Boat& boat, const WaterSim& waterSim, bool control[], float dt);
+
+/* bounds of all parts of a boat in object space */
+Bounds boatBounds(const Boat& boat);
+
+/* boats without parts of their own, placed on a grid around the origin, they are drawn with the parts of another boat */
+std::vector<Boat> boatFleetCreate(unsigned int count, float spacing);
+
+/* let uncontrolled boats float on the waves */
+void boatFleetMove(std::vector<Boat>& fleet, const WaterSim& waterSim, float dt);
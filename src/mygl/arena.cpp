@@ -0,0 +1,215 @@
+#include "arena.h"
+
+#include "glstate.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace detail
+{
+
+constexpr unsigned int noRange = std::numeric_limits<unsigned int>::max();
+
+/* first fit, returns noRange if no free range is large enough */
+unsigned int rangeAlloc(std::vector<ArenaRange>& free, unsigned int count)
+{
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    for(auto it = free.begin(); it != free.end(); ++it)
+    {
+        if(it->count >= count)
+        {
+            unsigned int first = it->first;
+            it->first += count;
+            it->count -= count;
+            if(it->count == 0)
+            {
+                free.erase(it);
+            }
+            return first;
+        }
+    }
+
+    return noRange;
+}
+
+void rangeFree(std::vector<ArenaRange>& free, unsigned int first, unsigned int count)
+{
+    if(count == 0)
+    {
+        return;
+    }
+
+    auto it = std::lower_bound(free.begin(), free.end(), first, [](const ArenaRange& r, unsigned int f) { return r.first < f; });
+    it = free.insert(it, ArenaRange{first, count});
+
+    /* merge with the following and the preceding range */
+    if(it + 1 != free.end() && it->first + it->count == (it + 1)->first)
+    {
+        it->count += (it + 1)->count;
+        free.erase(it + 1);
+    }
+    if(it != free.begin() && (it - 1)->first + (it - 1)->count == it->first)
+    {
+        (it - 1)->count += it->count;
+        free.erase(it);
+    }
+}
+
+MeshArenaPage* pageCreate(MeshArena& arena, GLenum indexType, unsigned int vertices, unsigned int indices)
+{
+    auto page = std::make_unique<MeshArenaPage>();
+    page->format = arena.format;
+    page->indexType = indexType;
+    page->vertexCapacity = vertices;
+    page->indexCapacity = indices;
+    page->freeVertices.push_back({0, vertices});
+    page->freeIndices.push_back({0, indices});
+
+    std::size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+    glGenVertexArrays(1, &page->vao);
+    glGenBuffers(1, &page->vbo);
+    glGenBuffers(1, &page->ebo);
+
+    stateBindVertexArray(page->vao);
+    {
+        stateBindBuffer(GL_ARRAY_BUFFER, page->vbo);
+        glBufferData(GL_ARRAY_BUFFER, std::size_t(vertices) * meshVertexSize(arena.format), nullptr, GL_STATIC_DRAW);
+        glCheckError();
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page->ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, std::size_t(indices) * indexSize, nullptr, GL_STATIC_DRAW);
+        glCheckError();
+
+        meshVertexAttributes(arena.format);
+        glCheckError();
+    }
+
+    if(arena.format & VertexPositionStream)
+    {
+        glGenVertexArrays(1, &page->depthVao);
+        glGenBuffers(1, &page->positionVbo);
+
+        stateBindVertexArray(page->depthVao);
+        stateBindBuffer(GL_ARRAY_BUFFER, page->positionVbo);
+        glBufferData(GL_ARRAY_BUFFER, std::size_t(vertices) * meshPositionSize(arena.format), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page->ebo);
+        meshPositionAttributes(arena.format);
+        glCheckError();
+    }
+
+    stateBindVertexArray(0);
+    stateBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    arena.pages.push_back(std::move(page));
+    return arena.pages.back().get();
+}
+
+}
+
+MeshArena meshArenaCreate(unsigned int format, unsigned int pageVertices, unsigned int pageIndices)
+{
+    MeshArena arena;
+    arena.format = format;
+    arena.pageVertices = pageVertices;
+    arena.pageIndices = pageIndices;
+    return arena;
+}
+
+void meshArenaDelete(MeshArena &arena)
+{
+    for(auto& page : arena.pages)
+    {
+        glDeleteBuffers(1, &page->vbo);
+        glDeleteBuffers(1, &page->ebo);
+        glDeleteVertexArrays(1, &page->vao);
+        if(page->depthVao != 0)
+        {
+            glDeleteBuffers(1, &page->positionVbo);
+            glDeleteVertexArrays(1, &page->depthVao);
+        }
+    }
+    stateInvalidate();
+
+    arena.pages.clear();
+}
+
+Mesh meshArenaAlloc(MeshArena &arena, const Vertex *vertices, std::size_t vertexCount, const unsigned int *indices, std::size_t indexCount)
+{
+    unsigned int vertexNum = static_cast<unsigned int>(vertexCount);
+    unsigned int indexNum = static_cast<unsigned int>(indexCount);
+    GLenum indexType = vertexCount < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    Mesh mesh;
+    mesh.size_vbo = vertexNum;
+    mesh.size_ibo = indexNum;
+    mesh.format = arena.format;
+    mesh.indexType = indexType;
+
+    /* both ranges have to fit into the same page */
+    for(auto& page : arena.pages)
+    {
+        if(page->indexType != indexType)
+        {
+            continue;
+        }
+
+        unsigned int baseVertex = detail::rangeAlloc(page->freeVertices, vertexNum);
+        if(baseVertex == detail::noRange)
+        {
+            continue;
+        }
+
+        unsigned int baseIndex = detail::rangeAlloc(page->freeIndices, indexNum);
+        if(baseIndex == detail::noRange)
+        {
+            detail::rangeFree(page->freeVertices, baseVertex, vertexNum);
+            continue;
+        }
+
+        mesh.page = page.get();
+        mesh.baseVertex = baseVertex;
+        mesh.baseIndex = baseIndex;
+        break;
+    }
+
+    if(mesh.page == nullptr)
+    {
+        MeshArenaPage* page = detail::pageCreate(arena, indexType, std::max(arena.pageVertices, vertexNum), std::max(arena.pageIndices, indexNum));
+        mesh.page = page;
+        mesh.baseVertex = detail::rangeAlloc(page->freeVertices, vertexNum);
+        mesh.baseIndex = detail::rangeAlloc(page->freeIndices, indexNum);
+    }
+
+    mesh.vao = mesh.page->vao;
+    mesh.vbo = mesh.page->vbo;
+    mesh.ebo = mesh.page->ebo;
+    mesh.positionVbo = mesh.page->positionVbo;
+    mesh.depthVao = mesh.page->depthVao;
+
+    if((arena.format & VertexQuantizedPosition) && vertices != nullptr)
+    {
+        meshFitPositions(mesh, vertices, vertexCount);
+    }
+    if(vertices != nullptr)
+    {
+        meshUploadVertices(mesh, 0, vertices, vertexCount);
+    }
+    if(indices != nullptr)
+    {
+        meshUploadIndices(mesh, 0, indices, indexCount);
+    }
+
+    return mesh;
+}
+
+void meshArenaFree(const Mesh &mesh)
+{
+    detail::rangeFree(mesh.page->freeVertices, mesh.baseVertex, mesh.size_vbo);
+    detail::rangeFree(mesh.page->freeIndices, mesh.baseIndex, mesh.size_ibo);
+}
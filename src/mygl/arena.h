@@ -0,0 +1,87 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <memory>
+#include <vector>
+
+/* free range of vertices or indices inside a page */
+struct ArenaRange
+{
+    unsigned int first;
+    unsigned int count;
+};
+
+/* one set of large buffers with a single VAO, all meshes of a page can be drawn without rebinding */
+struct MeshArenaPage
+{
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+
+    /* position-only stream of all meshes of the page, only with VertexPositionStream (see mesh.h) */
+    GLuint positionVbo = 0;
+    GLuint depthVao = 0;
+
+    unsigned int format = VertexFloat;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+
+    unsigned int vertexCapacity = 0;
+    unsigned int indexCapacity = 0;
+
+    /* sorted by first, neighbouring ranges are merged */
+    std::vector<ArenaRange> freeVertices;
+    std::vector<ArenaRange> freeIndices;
+};
+
+struct MeshArena
+{
+    /* all meshes of the arena use the same vertex format */
+    unsigned int format = VertexFloat;
+
+    /* size of new pages, larger meshes get a page of their own */
+    unsigned int pageVertices = 0;
+    unsigned int pageIndices = 0;
+
+    std::vector<std::unique_ptr<MeshArenaPage>> pages;
+};
+
+/**
+ * @brief Create an arena that sub-allocates static meshes from a few large vertex and index buffers. Meshes with less
+ * than 65536 vertices go to pages with 16 bit indices, larger ones to pages with 32 bit indices.
+ *
+ * @param format Combination of eVertexFormat flags used for all meshes of the arena.
+ * @param pageVertices Number of vertices per page.
+ * @param pageIndices Number of indices per page.
+ *
+ * @return Empty arena, pages are created on demand.
+ */
+MeshArena meshArenaCreate(unsigned int format = VertexFloat, unsigned int pageVertices = 1 << 18, unsigned int pageIndices = 1 << 20);
+
+/**
+ * @brief Delete all pages of an arena. All meshes allocated from it have to be deleted before.
+ *
+ * @param arena Arena to delete.
+ */
+void meshArenaDelete(MeshArena& arena);
+
+/**
+ * @brief Allocate a mesh inside the arena and fill it with data. Works like meshCreate: if vertices or indices are
+ * nullptr the ranges are only reserved and can be filled with meshUploadVertices / meshUploadIndices.
+ *
+ * @param arena Arena to allocate from.
+ * @param vertices Pointer to vertexCount vertices.
+ * @param vertexCount Number of vertices.
+ * @param indices Pointer to indexCount indices.
+ * @param indexCount Number of indices.
+ *
+ * @return Mesh that shares the VAO and buffers of its page, drawn with glDrawElementsBaseVertex.
+ */
+Mesh meshArenaAlloc(MeshArena& arena, const Vertex* vertices, std::size_t vertexCount, const unsigned int* indices, std::size_t indexCount);
+
+/**
+ * @brief Return the ranges of a mesh to its page (called by meshDelete).
+ *
+ * @param mesh Mesh allocated with meshArenaAlloc.
+ */
+void meshArenaFree(const Mesh& mesh);
@@ -31,6 +31,21 @@ GLenum glCheckError_(const char *file, int line)
     return errorCode;
 }
 
+void glLoadCore33(GLADloadproc load)
+{
+    if(glVersionAtLeast(3, 3) && !GLAD_GL_ARB_timer_query)
+    {
+        glad_glQueryCounter = (PFNGLQUERYCOUNTERPROC)load("glQueryCounter");
+        glad_glGetQueryObjecti64v = (PFNGLGETQUERYOBJECTI64VPROC)load("glGetQueryObjecti64v");
+        glad_glGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)load("glGetQueryObjectui64v");
+    }
+}
+
+bool glVersionAtLeast(int major, int minor)
+{
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
 void screenshotToPNG(const std::string &filepath)
 {
     GLint viewport[4];
@@ -98,6 +113,7 @@ GLFWwindow* windowCreate(const std::string& title, unsigned int width = 1280, un
         windowDelete(window);
         return nullptr;
     }
+    glLoadCore33((GLADloadproc) glfwGetProcAddress);
 
     return window;
 }
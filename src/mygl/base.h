@@ -35,6 +35,25 @@ GLFWwindow* windowCreate(const std::string &title, unsigned int width, unsigned
  */
 void windowDelete(GLFWwindow* window);
 
+/**
+ * @brief Load the OpenGL 3.3 functions that the GLAD loader (generated for 3.2 and extensions) only loads if the driver
+ * lists their extension, e.g. the timestamp queries of GL_ARB_timer_query on core contexts that don't list it. Has to be
+ * called after gladLoadGLLoader.
+ *
+ * @param load Function that returns the address of an OpenGL function (e.g. glfwGetProcAddress).
+ */
+void glLoadCore33(GLADloadproc load);
+
+/**
+ * @brief Check the version of the current OpenGL context (after gladLoadGLLoader).
+ *
+ * @param major Major version.
+ * @param minor Minor version.
+ *
+ * @return True if the context has at least this version.
+ */
+bool glVersionAtLeast(int major, int minor);
+
 /**
  * @brief Save current viewport as PNG image.
  *
@@ -0,0 +1,275 @@
+#include "batch.h"
+
+#include "glstate.h"
+
+#include <algorithm>
+
+namespace detail
+{
+
+/* RGBA32F buffer texture */
+void textureBufferCreate(GLuint& buffer, GLuint& texture)
+{
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+
+    stateBindTexture(GL_TEXTURE_BUFFER, texture);
+    stateBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    stateBindBuffer(GL_TEXTURE_BUFFER, 0);
+    stateBindTexture(GL_TEXTURE_BUFFER, 0);
+    glCheckError();
+}
+
+/* reallocate (orphan) the buffer every frame, so the driver doesn't wait for draws of the last frame */
+void textureBufferUpload(GLuint buffer, std::size_t& capacity, const std::vector<Vector4D>& data)
+{
+    std::size_t size = data.size() * sizeof(Vector4D);
+    capacity = std::max(capacity, size);
+    stateBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data.data());
+}
+
+DrawList& drawList(DrawBatch& batch, const Mesh& mesh)
+{
+    if(batch.lists.empty() || batch.lists.back().vao != mesh.vao || batch.lists.back().indexType != mesh.indexType)
+    {
+        DrawList list;
+        list.vao = mesh.vao;
+        list.depthVao = mesh.depthVao;
+        list.indexType = mesh.indexType;
+        list.firstDraw = static_cast<unsigned int>(batch.data.size() / drawDataTexels);
+        batch.lists.push_back(std::move(list));
+    }
+
+    return batch.lists.back();
+}
+
+void drawData(DrawBatch& batch, DrawList& list, const Mesh& mesh, const Material& material, const Matrix4D& transform, unsigned int firstInstance = 0)
+{
+    batch.uploaded = false;
+
+    list.counts.push_back(static_cast<GLsizei>(material.indexCount));
+    list.offsets.push_back(meshIndexOffset(mesh, material.indexOffset));
+    list.baseVertices.push_back(static_cast<GLint>(mesh.baseVertex));
+
+    batch.data.push_back(Vector4D(material.ambient, material.shininess));
+    batch.data.push_back(Vector4D(material.diffuse, 0.0f));
+    batch.data.push_back(Vector4D(material.specular, 0.0f));
+    batch.data.push_back(Vector4D(mesh.positionOffset, static_cast<float>(firstInstance)));
+    batch.data.push_back(Vector4D(mesh.positionScale, 0.0f));
+    for(int column = 0; column < 4; column++)
+    {
+        batch.data.push_back(transform[column]);
+    }
+}
+
+/* upload the per draw data and bind it to texture unit 0 */
+void drawDataBind(DrawBatch& batch, ShaderProgram& shader)
+{
+    if(!batch.uploaded)
+    {
+        textureBufferUpload(batch.buffer, batch.capacity, batch.data);
+        batch.uploaded = true;
+    }
+
+    stateActiveTexture(GL_TEXTURE0);
+    stateBindTexture(GL_TEXTURE_BUFFER, batch.texture);
+    shaderUniform(shader, "uDrawData", 0);
+}
+
+GLuint listVao(const DrawList& list, bool depthOnly)
+{
+    return depthOnly && list.depthVao != 0 ? list.depthVao : list.vao;
+}
+
+/* all draws of a list in one call, gl_DrawIDARB counts the draws inside the call */
+void multiDraw(const DrawList& list, UniformHandle drawOffset)
+{
+    shaderUniform(drawOffset, static_cast<int>(list.firstDraw));
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, list.counts.data(), list.indexType, list.offsets.data(),
+                                  static_cast<GLsizei>(list.counts.size()), list.baseVertices.data());
+}
+
+}
+
+DrawBatch drawBatchCreate()
+{
+    DrawBatch batch;
+    detail::textureBufferCreate(batch.buffer, batch.texture);
+    return batch;
+}
+
+void drawBatchDelete(DrawBatch &batch)
+{
+    glDeleteTextures(1, &batch.texture);
+    glDeleteBuffers(1, &batch.buffer);
+    stateInvalidate();
+    batch = DrawBatch{};
+}
+
+void drawBatchClear(DrawBatch &batch)
+{
+    batch.lists.clear();
+    batch.data.clear();
+    batch.uploaded = false;
+}
+
+void drawBatchAdd(DrawBatch &batch, const Mesh &mesh, const Material &material, const Matrix4D &transform)
+{
+    if(material.indexCount == 0)
+    {
+        return;
+    }
+
+    detail::drawData(batch, detail::drawList(batch, mesh), mesh, material, transform);
+}
+
+void drawBatchSubmit(DrawBatch &batch, ShaderProgram &shader, bool depthOnly)
+{
+    if(batch.lists.empty())
+    {
+        return;
+    }
+
+    detail::drawDataBind(batch, shader);
+
+    UniformHandle drawOffset = shaderUniformHandle(shader, "uDrawOffset");
+    for(const auto& list : batch.lists)
+    {
+        stateBindVertexArray(detail::listVao(list, depthOnly));
+
+        if(GLAD_GL_ARB_shader_draw_parameters)
+        {
+            detail::multiDraw(list, drawOffset);
+        }
+        else
+        {
+            for(std::size_t i = 0; i < list.counts.size(); i++)
+            {
+                shaderUniform(drawOffset, static_cast<int>(list.firstDraw + i));
+                glDrawElementsBaseVertex(GL_TRIANGLES, list.counts[i], list.indexType, list.offsets[i], list.baseVertices[i]);
+            }
+        }
+    }
+    glCheckError();
+
+    /* buffer, texture and VAO stay bound, the state cache skips binding them again for the next batch or frame */
+}
+
+void drawBatchAddInstanced(DrawBatch &batch, const Mesh &mesh, const Material &material, const Matrix4D &transform, unsigned int firstInstance, unsigned int instanceCount)
+{
+    if(material.indexCount == 0 || instanceCount == 0)
+    {
+        return;
+    }
+
+    DrawList& list = detail::drawList(batch, mesh);
+    list.instanceCounts.push_back(static_cast<GLsizei>(instanceCount));
+    detail::drawData(batch, list, mesh, material, transform, firstInstance);
+}
+
+void drawBatchSubmitInstanced(DrawBatch &batch, ShaderProgram &shader, InstanceBuffer &instances, bool depthOnly)
+{
+    if(batch.lists.empty())
+    {
+        return;
+    }
+
+    detail::drawDataBind(batch, shader);
+
+    if(!instances.uploaded)
+    {
+        detail::textureBufferUpload(instances.buffer, instances.capacity, instances.data);
+        instances.uploaded = true;
+    }
+    stateActiveTexture(GL_TEXTURE1);
+    stateBindTexture(GL_TEXTURE_BUFFER, instances.texture);
+    shaderUniform(shader, "uInstanceData", 1);
+
+    /* there is no instanced multi draw before GL 4.3: lists whose draws have a single instance each (e.g. a scene with
+       one boat) are still one multi draw, the first instance is part of the per draw data. Otherwise one call per draw
+       covers all of its instances. */
+    UniformHandle drawOffset = shaderUniformHandle(shader, "uDrawOffset");
+    for(const auto& list : batch.lists)
+    {
+        stateBindVertexArray(detail::listVao(list, depthOnly));
+
+        bool singleInstances = std::all_of(list.instanceCounts.begin(), list.instanceCounts.end(), [](GLsizei count) { return count == 1; });
+        if(singleInstances && GLAD_GL_ARB_shader_draw_parameters)
+        {
+            detail::multiDraw(list, drawOffset);
+            continue;
+        }
+
+        for(std::size_t i = 0; i < list.counts.size(); i++)
+        {
+            shaderUniform(drawOffset, static_cast<int>(list.firstDraw + i));
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, list.counts[i], list.indexType, list.offsets[i],
+                                              list.instanceCounts[i], list.baseVertices[i]);
+        }
+    }
+    glCheckError();
+}
+
+void drawBatchSubmitArrays(DrawBatch &batch, ShaderProgram &shader, GLenum mode)
+{
+    if(batch.lists.empty())
+    {
+        return;
+    }
+
+    detail::drawDataBind(batch, shader);
+
+    UniformHandle drawOffset = shaderUniformHandle(shader, "uDrawOffset");
+    for(const auto& list : batch.lists)
+    {
+        stateBindVertexArray(list.vao);
+
+        for(std::size_t i = 0; i < list.counts.size(); i++)
+        {
+            shaderUniform(drawOffset, static_cast<int>(list.firstDraw + i));
+            glDrawArraysInstanced(mode, list.baseVertices[i], list.counts[i], list.instanceCounts[i]);
+        }
+    }
+    glCheckError();
+}
+
+InstanceBuffer instanceBufferCreate()
+{
+    InstanceBuffer instances;
+    detail::textureBufferCreate(instances.buffer, instances.texture);
+    return instances;
+}
+
+void instanceBufferDelete(InstanceBuffer &instances)
+{
+    glDeleteTextures(1, &instances.texture);
+    glDeleteBuffers(1, &instances.buffer);
+    stateInvalidate();
+    instances = InstanceBuffer{};
+}
+
+void instanceBufferClear(InstanceBuffer &instances)
+{
+    instances.data.clear();
+    instances.uploaded = false;
+}
+
+unsigned int instanceBufferAdd(InstanceBuffer &instances, const Matrix4D &transform, const Vector4D &tint)
+{
+    unsigned int index = instanceBufferCount(instances);
+    instances.uploaded = false;
+    for(int column = 0; column < 4; column++)
+    {
+        instances.data.push_back(transform[column]);
+    }
+    instances.data.push_back(tint);
+    return index;
+}
+
+unsigned int instanceBufferCount(const InstanceBuffer &instances)
+{
+    return static_cast<unsigned int>(instances.data.size() / instanceDataTexels);
+}
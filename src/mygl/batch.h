@@ -0,0 +1,176 @@
+#pragma once
+
+#include "model.h"
+#include "shader.h"
+
+#include <vector>
+
+/* number of RGBA32F texels of per draw data: ambient + shininess, diffuse, specular, position offset + first instance,
+   position scale and the 4 columns of the model matrix */
+constexpr unsigned int drawDataTexels = 9;
+
+/* number of RGBA32F texels of per instance data: the 4 columns of the instance matrix and a tint color */
+constexpr unsigned int instanceDataTexels = 5;
+
+/* draws that share a VAO (one arena page) and are submitted with a single multi draw call */
+struct DrawList
+{
+    GLuint vao = 0;
+    /* VAO of the position-only stream of the meshes (0 if they have none), used by depth-only submits */
+    GLuint depthVao = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    unsigned int firstDraw = 0;
+
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+
+    /* number of instances per draw, only filled by drawBatchAddInstanced (the first instance is in the per draw data) */
+    std::vector<GLsizei> instanceCounts;
+};
+
+struct DrawBatch
+{
+    /* buffer texture holding drawDataTexels texels per draw, read in the shaders with texelFetch */
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    std::size_t capacity = 0;
+
+    std::vector<DrawList> lists;
+    std::vector<Vector4D> data;
+
+    /* data is in the buffer, a batch submitted again (e.g. after a depth pre-pass) doesn't upload it again */
+    bool uploaded = false;
+};
+
+/* per instance transforms and tints, streamed every frame into a buffer texture */
+struct InstanceBuffer
+{
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    std::size_t capacity = 0;
+
+    std::vector<Vector4D> data;
+    bool uploaded = false;
+};
+
+/**
+ * @brief Create an empty draw batch with its per draw data buffer.
+ *
+ * @return Draw batch.
+ */
+DrawBatch drawBatchCreate();
+
+/**
+ * @brief Delete the buffer and texture of a draw batch.
+ *
+ * @param batch Draw batch to delete.
+ */
+void drawBatchDelete(DrawBatch& batch);
+
+/**
+ * @brief Remove all draws (done once per frame before the batch is filled again).
+ *
+ * @param batch Draw batch.
+ */
+void drawBatchClear(DrawBatch& batch);
+
+/**
+ * @brief Add the index range of a material to the batch. Consecutive draws of meshes with the same VAO end up in the
+ * same multi draw call.
+ *
+ * @param batch Draw batch.
+ * @param mesh Mesh the material belongs to.
+ * @param material Material with index range.
+ * @param transform Model matrix of the draw.
+ */
+void drawBatchAdd(DrawBatch& batch, const Mesh& mesh, const Material& material, const Matrix4D& transform);
+
+/**
+ * @brief Upload the per draw data and submit one glMultiDrawElementsBaseVertex per VAO. The shader gets the draw data
+ * as samplerBuffer uDrawData (texture unit 0) and the index of the first draw as uDrawOffset. Without
+ * GL_ARB_shader_draw_parameters the draws of a list are issued one by one with increasing uDrawOffset.
+ *
+ * @param batch Draw batch.
+ * @param shader Shader program that is currently in use.
+ * @param depthOnly Draw with the position-only VAOs of the meshes where they have one (for depth passes).
+ */
+void drawBatchSubmit(DrawBatch& batch, ShaderProgram& shader, bool depthOnly = false);
+
+/**
+ * @brief Add the index range of a material that is drawn once for each instance of a range of the instance buffer.
+ * A batch has to be either filled with drawBatchAdd or with drawBatchAddInstanced.
+ *
+ * @param batch Draw batch.
+ * @param mesh Mesh the material belongs to.
+ * @param material Material with index range.
+ * @param transform Model matrix of the draw, applied before the instance matrix.
+ * @param firstInstance Index of the first instance in the instance buffer.
+ * @param instanceCount Number of instances.
+ */
+void drawBatchAddInstanced(DrawBatch& batch, const Mesh& mesh, const Material& material, const Matrix4D& transform, unsigned int firstInstance, unsigned int instanceCount);
+
+/**
+ * @brief Upload per draw and per instance data and issue one glDrawElementsInstancedBaseVertex per draw. Lists whose
+ * draws all have a single instance are submitted like drawBatchSubmit, with one glMultiDrawElementsBaseVertex. The
+ * shader (compiled with INSTANCED) gets the instance data as samplerBuffer uInstanceData (texture unit 1) in addition to
+ * the uniforms of drawBatchSubmit, the first instance of a draw is stored in its per draw data.
+ *
+ * @param batch Draw batch filled with drawBatchAddInstanced.
+ * @param shader Shader program that is currently in use.
+ * @param instances Instance buffer the instance ranges refer to.
+ * @param depthOnly Draw with the position-only VAOs of the meshes where they have one (for depth passes).
+ */
+void drawBatchSubmitInstanced(DrawBatch& batch, ShaderProgram& shader, InstanceBuffer& instances, bool depthOnly = false);
+
+/**
+ * @brief Upload per draw data and issue one glDrawArraysInstanced per draw, for geometry that the vertex shader
+ * generates from gl_VertexID and gl_InstanceID (see Clipmap in grid.h). The index count of a material is the vertex
+ * count, the base vertex of the mesh the first vertex and the instance range only its count.
+ *
+ * @param batch Draw batch filled with drawBatchAddInstanced.
+ * @param shader Shader program that is currently in use.
+ * @param mode Primitive type.
+ */
+void drawBatchSubmitArrays(DrawBatch& batch, ShaderProgram& shader, GLenum mode);
+
+/**
+ * @brief Create an empty instance buffer.
+ *
+ * @return Instance buffer.
+ */
+InstanceBuffer instanceBufferCreate();
+
+/**
+ * @brief Delete the buffer and texture of an instance buffer.
+ *
+ * @param instances Instance buffer to delete.
+ */
+void instanceBufferDelete(InstanceBuffer& instances);
+
+/**
+ * @brief Remove all instances (done once per frame before the buffer is filled again).
+ *
+ * @param instances Instance buffer.
+ */
+void instanceBufferClear(InstanceBuffer& instances);
+
+/**
+ * @brief Append an instance.
+ *
+ * @param instances Instance buffer.
+ * @param transform Instance matrix.
+ * @param tint Color the lighting of the instance is multiplied with.
+ *
+ * @return Index of the instance.
+ */
+unsigned int instanceBufferAdd(InstanceBuffer& instances, const Matrix4D& transform, const Vector4D& tint = {1.0f, 1.0f, 1.0f, 1.0f});
+
+/**
+ * @brief Number of instances in the buffer.
+ *
+ * @param instances Instance buffer.
+ *
+ * @return Number of instances.
+ */
+unsigned int instanceBufferCount(const InstanceBuffer& instances);
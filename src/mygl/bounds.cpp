@@ -0,0 +1,181 @@
+#include "bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define MYGL_CULL_SSE 1
+#endif
+
+Bounds boundsCompute(const Vector3D *positions, std::size_t stride, const unsigned int *indices, std::size_t count)
+{
+    Bounds bounds;
+    if(count == 0)
+    {
+        return bounds;
+    }
+
+    auto position = [&](std::size_t i) -> const Vector3D& {
+        std::size_t v = indices ? indices[i] : i;
+        return *reinterpret_cast<const Vector3D*>(reinterpret_cast<const char*>(positions) + v * stride);
+    };
+
+    bounds.min = bounds.max = position(0);
+    for(std::size_t i = 1; i < count; i++)
+    {
+        const Vector3D& p = position(i);
+        for(unsigned int a = 0; a < 3; a++)
+        {
+            bounds.min[a] = std::min(bounds.min[a], p[a]);
+            bounds.max[a] = std::max(bounds.max[a], p[a]);
+        }
+    }
+
+    bounds.center = 0.5f * (bounds.min + bounds.max);
+    for(std::size_t i = 0; i < count; i++)
+    {
+        bounds.radius = std::max(bounds.radius, length(position(i) - bounds.center));
+    }
+
+    return bounds;
+}
+
+Bounds boundsMerge(const Bounds &a, const Bounds &b)
+{
+    Bounds bounds;
+    for(unsigned int i = 0; i < 3; i++)
+    {
+        bounds.min[i] = std::min(a.min[i], b.min[i]);
+        bounds.max[i] = std::max(a.max[i], b.max[i]);
+    }
+
+    bounds.center = 0.5f * (bounds.min + bounds.max);
+    bounds.radius = std::max(length(a.center - bounds.center) + a.radius, length(b.center - bounds.center) + b.radius);
+    return bounds;
+}
+
+Bounds boundsTransform(const Bounds &bounds, const Matrix4D &transformation)
+{
+    const Matrix4D& m = transformation;
+
+    /* center and half extent of the box, the new extent is |M| * extent (Arvo) */
+    Vector3D center = 0.5f * (bounds.min + bounds.max);
+    Vector3D extent = 0.5f * (bounds.max - bounds.min);
+
+    Bounds result;
+    Vector3D boxCenter;
+    Vector3D boxExtent;
+    for(int i = 0; i < 3; i++)
+    {
+        boxCenter[i] = m(i, 3);
+        for(int j = 0; j < 3; j++)
+        {
+            boxCenter[i] += m(i, j) * center[j];
+            boxExtent[i] += std::abs(m(i, j)) * extent[j];
+        }
+    }
+    result.min = boxCenter - boxExtent;
+    result.max = boxCenter + boxExtent;
+
+    float scale = 0.0f;
+    for(int j = 0; j < 3; j++)
+    {
+        scale = std::max(scale, length(Vector3D(m(0, j), m(1, j), m(2, j))));
+    }
+    result.center = Vector3D(m * Vector4D(bounds.center, 1.0f));
+    result.radius = bounds.radius * scale;
+
+    return result;
+}
+
+Frustum frustumExtract(const Matrix4D &viewProjection)
+{
+    const Matrix4D& m = viewProjection;
+    auto row = [&](int i) { return Vector4D(m(i, 0), m(i, 1), m(i, 2), m(i, 3)); };
+
+    Frustum frustum;
+    frustum.planes[0] = row(3) + row(0);
+    frustum.planes[1] = row(3) - row(0);
+    frustum.planes[2] = row(3) + row(1);
+    frustum.planes[3] = row(3) - row(1);
+    frustum.planes[4] = row(3) + row(2);
+    frustum.planes[5] = row(3) - row(2);
+
+    for(auto& plane : frustum.planes)
+    {
+        float l = length(Vector3D(plane.x, plane.y, plane.z));
+        plane = l > 0.0f ? plane / l : plane;
+    }
+
+    return frustum;
+}
+
+std::size_t frustumCullSpheres(const Frustum &frustum, const float *x, const float *y, const float *z, const float *radius, std::size_t count, std::uint8_t *visible)
+{
+    std::size_t visibleCount = 0;
+    std::size_t i = 0;
+
+#ifdef MYGL_CULL_SSE
+    __m128 px[6], py[6], pz[6], pd[6];
+    for(int p = 0; p < 6; p++)
+    {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pd[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+        __m128 r = _mm_loadu_ps(radius + i);
+
+        /* inside all planes: distance + radius >= 0 (the mask starts with all bits set, NaN centers are culled) */
+        __m128 inside = _mm_cmpeq_ps(cx, cx);
+        for(int p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)), _mm_add_ps(_mm_mul_ps(pz[p], cz), pd[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for(int k = 0; k < 4; k++)
+        {
+            visible[i + k] = (mask >> k) & 1;
+            visibleCount += visible[i + k];
+        }
+    }
+#endif
+
+    for(; i < count; i++)
+    {
+        bool inside = true;
+        for(const auto& plane : frustum.planes)
+        {
+            inside = inside && plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w + radius[i] >= 0.0f;
+        }
+        visible[i] = inside ? 1 : 0;
+        visibleCount += visible[i];
+    }
+
+    return visibleCount;
+}
+
+bool frustumTestBox(const Frustum &frustum, const Bounds &bounds)
+{
+    for(const auto& plane : frustum.planes)
+    {
+        float px = plane.x >= 0.0f ? bounds.max.x : bounds.min.x;
+        float py = plane.y >= 0.0f ? bounds.max.y : bounds.min.y;
+        float pz = plane.z >= 0.0f ? bounds.max.z : bounds.min.z;
+        if(plane.x * px + plane.y * py + plane.z * pz + plane.w < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <math/vector3d.h>
+#include <math/vector4d.h>
+#include <math/matrix4d.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/* axis aligned box and sphere around the same geometry */
+struct Bounds
+{
+    Vector3D min;
+    Vector3D max;
+
+    /* sphere around the center of the box */
+    Vector3D center;
+    float radius = 0.0f;
+};
+
+/* six planes (left, right, bottom, top, near, far) with normals pointing inside, ax + by + cz + d >= 0 inside */
+struct Frustum
+{
+    Vector4D planes[6];
+};
+
+/**
+ * @brief Bounds of the vertices referenced by a range of indices.
+ *
+ * @param positions Pointer to the first position, consecutive positions are stride bytes apart.
+ * @param stride Distance between positions in bytes (e.g. sizeof(Vertex)).
+ * @param indices Index buffer, nullptr to use all count positions.
+ * @param count Number of indices (or positions).
+ *
+ * @return Bounds, empty (zero radius at the origin) if count is 0.
+ */
+Bounds boundsCompute(const Vector3D* positions, std::size_t stride, const unsigned int* indices, std::size_t count);
+
+/**
+ * @brief Bounds around two bounds, the sphere is centered at the center of the merged box.
+ *
+ * @param a First bounds.
+ * @param b Second bounds.
+ *
+ * @return Bounds containing both.
+ */
+Bounds boundsMerge(const Bounds& a, const Bounds& b);
+
+/**
+ * @brief Bounds of transformed geometry: the box is the box around the transformed box, the sphere radius is scaled by
+ * the largest axis scale of the matrix.
+ *
+ * @param bounds Bounds in object space.
+ * @param transformation Affine transformation.
+ *
+ * @return Bounds in the space of the transformation.
+ */
+Bounds boundsTransform(const Bounds& bounds, const Matrix4D& transformation);
+
+/**
+ * @brief Extract the normalized planes of the view frustum (Gribb/Hartmann).
+ *
+ * @param viewProjection Projection matrix times view matrix.
+ *
+ * @return Frustum in world space.
+ */
+Frustum frustumExtract(const Matrix4D& viewProjection);
+
+/**
+ * @brief Test spheres in structure of arrays layout against all planes, four spheres at a time with SSE (scalar on other
+ * platforms). A sphere is visible unless it is completely on the outer side of one plane.
+ *
+ * @param frustum Frustum.
+ * @param x Sphere centers x.
+ * @param y Sphere centers y.
+ * @param z Sphere centers z.
+ * @param radius Sphere radii.
+ * @param count Number of spheres.
+ * @param visible Receives 1 for visible and 0 for culled spheres.
+ *
+ * @return Number of visible spheres.
+ */
+std::size_t frustumCullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius, std::size_t count, std::uint8_t* visible);
+
+/**
+ * @brief Exact test of an axis aligned box against all planes (the corner furthest along the plane normal decides).
+ *
+ * @param frustum Frustum.
+ * @param bounds Bounds, only min and max are used.
+ *
+ * @return False if the box is completely outside.
+ */
+bool frustumTestBox(const Frustum& frustum, const Bounds& bounds);
@@ -3,6 +3,9 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
 
 namespace detail
 {
@@ -70,3 +73,50 @@ void cameraFollow(Camera& cam, const Vector3D& pos)
     cam.position += pos - cam.lookAt;
     cam.lookAt = pos;
 }
+
+std::vector<CameraKey> cameraPathLoad(const std::string& filepath)
+{
+    std::ifstream file(filepath);
+    if(!file.is_open())
+    {
+        throw std::runtime_error("[Camera] Couldn't open camera path at " + filepath);
+    }
+
+    std::vector<CameraKey> path;
+    std::string line;
+    for(unsigned int number = 1; std::getline(file, line); number++)
+    {
+        std::stringstream ss(line);
+        std::string first;
+        if(!(ss >> first) || first[0] == '#')
+        {
+            continue;
+        }
+
+        ss.seekg(0);
+        CameraKey key;
+        if(!(ss >> key.position.x >> key.position.y >> key.position.z >> key.lookAt.x >> key.lookAt.y >> key.lookAt.z))
+        {
+            throw std::runtime_error("[Camera] Invalid keyframe in " + filepath + " (line " + std::to_string(number) + ")");
+        }
+        path.push_back(key);
+    }
+
+    return path;
+}
+
+void cameraPathApply(Camera& cam, const std::vector<CameraKey>& path, float t)
+{
+    if(path.empty())
+    {
+        return;
+    }
+
+    float segment = std::clamp(t, 0.0f, 1.0f) * float(path.size() - 1);
+    std::size_t first = std::min(static_cast<std::size_t>(segment), path.size() - 1);
+    std::size_t second = std::min(first + 1, path.size() - 1);
+    float blend = segment - float(first);
+
+    cam.position = path[first].position * (1.0f - blend) + path[second].position * blend;
+    cam.lookAt = path[first].lookAt * (1.0f - blend) + path[second].lookAt * blend;
+}
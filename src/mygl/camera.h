@@ -4,6 +4,16 @@
 #include <math/vector3d.h>
 #include <math/matrix4d.h>
 
+#include <string>
+#include <vector>
+
+/* keyframe of a camera path */
+struct CameraKey
+{
+    Vector3D position;
+    Vector3D lookAt;
+};
+
 struct Camera
 {
     float width;
@@ -68,3 +78,22 @@ void cameraUpdateOrbit(Camera &cam, const Vector2D &mouseDiff, float zoom);
  * @param pos New lookAt position.
  */
 void cameraFollow(Camera& cam, const Vector3D& pos);
+
+/**
+ * @brief Load a camera path from a text file. Every line is one keyframe "px py pz lx ly lz" (position and look at
+ * point in world space), empty lines and lines starting with # are ignored.
+ *
+ * @param filepath Path to the camera path file.
+ *
+ * @return Keyframes in the order of the file.
+ */
+std::vector<CameraKey> cameraPathLoad(const std::string& filepath);
+
+/**
+ * @brief Place a camera on a path, the keyframes are spread evenly over the path and interpolated linearly.
+ *
+ * @param cam Camera that gets updated.
+ * @param path Keyframes (nothing happens for an empty path).
+ * @param t Position on the path from 0 (first keyframe) to 1 (last keyframe).
+ */
+void cameraPathApply(Camera& cam, const std::vector<CameraKey>& path, float t);
@@ -0,0 +1,335 @@
+#include "capture.h"
+
+#include "glstate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <stb_image/stb_image_write.h>
+
+namespace detail
+{
+
+bool signaled(const CaptureSlot& slot)
+{
+    /* the flush makes sure the fence reaches the GPU even if nothing else flushes before the next check */
+    GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+void wait(const CaptureSlot& slot)
+{
+    while(glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+    {
+    }
+}
+
+void checkPixels(const CaptureJob& job)
+{
+    if(job.pixels.empty())
+    {
+        throw std::runtime_error("couldn't map pixel buffer");
+    }
+}
+
+void putBigEndian(std::vector<unsigned char>& out, std::uint32_t value)
+{
+    for(int shift = 24; shift >= 0; shift -= 8)
+    {
+        out.push_back(static_cast<unsigned char>(value >> shift));
+    }
+}
+
+bool poll(CaptureJob& job)
+{
+    if(job.state != CaptureEncoding)
+    {
+        return true;
+    }
+
+    if(job._encoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return false;
+    }
+
+    try
+    {
+        job._encoded.get();
+        job.state = CaptureDone;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "[Capture] Couldn't write " << job.path << ": " << e.what() << std::endl;
+        job.error = e.what();
+        job.state = CaptureFailed;
+    }
+
+    return true;
+}
+
+/* copy the pixels of a finished read out of its buffer and queue them for encoding, the encoder also gets jobs whose
+   buffer couldn't be mapped (encoders that write streams have to see every frame) */
+void map(Capture& capture, CaptureSlot& slot)
+{
+    std::shared_ptr<CaptureJob> job = std::move(slot.job);
+    std::size_t size = 4 * std::size_t(job->width) * job->height;
+
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if(pixels != nullptr)
+    {
+        job->pixels.resize(size);
+        std::memcpy(job->pixels.data(), pixels, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glCheckError();
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    /* backpressure: wait for the oldest job instead of queueing frames faster than they are encoded */
+    if(capture.maxEncoding > 0 && capture.encoding.size() >= capture.maxEncoding)
+    {
+        capture.stalls++;
+        threadPoolWait(capture.encoder, capture.encoding.front()->_encoded);
+        auto finished = [](const auto& job) { return poll(*job); };
+        capture.encoding.erase(std::remove_if(capture.encoding.begin(), capture.encoding.end(), finished), capture.encoding.end());
+    }
+
+    job->state = CaptureEncoding;
+    job->_encoded = threadPoolSubmit(capture.encoder, [job]() {
+        try
+        {
+            job->_encode(*job);
+        }
+        catch(...)
+        {
+            job->pixels = {};
+            throw;
+        }
+        job->pixels = {};
+    });
+    capture.encoding.push_back(std::move(job));
+}
+
+}
+
+Capture captureCreate(unsigned int slots, unsigned int encoderThreads, std::size_t maxEncoding)
+{
+    Capture capture;
+    capture.slots.resize(std::max(slots, 1u));
+    for(auto& slot : capture.slots)
+    {
+        glGenBuffers(1, &slot.pbo);
+    }
+    glCheckError();
+
+    capture.encoder = threadPoolCreate(std::max(encoderThreads, 1u));
+    capture.maxEncoding = maxEncoding;
+    return capture;
+}
+
+void captureDelete(Capture &capture)
+{
+    captureFinish(capture);
+
+    for(auto& slot : capture.slots)
+    {
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    stateInvalidate();
+    threadPoolDelete(capture.encoder);
+
+    capture = Capture{};
+}
+
+std::shared_ptr<CaptureJob> captureRead(Capture &capture, GLuint framebuffer, GLenum readBuffer, unsigned int width, unsigned int height, const std::string &filepath)
+{
+    bool qoi = filepath.size() >= 4 && filepath.compare(filepath.size() - 4, 4, ".qoi") == 0;
+    auto job = captureRead(capture, framebuffer, readBuffer, width, height, qoi ? captureWriteQOI : captureWritePNG);
+    job->path = filepath;
+    return job;
+}
+
+std::shared_ptr<CaptureJob> captureRead(Capture &capture, GLuint framebuffer, GLenum readBuffer, unsigned int width, unsigned int height, std::function<void(CaptureJob&)> encode)
+{
+    /* all reads in flight, the oldest one has to finish before its buffer can be used again */
+    CaptureSlot& slot = capture.slots[capture.next];
+    capture.next = (capture.next + 1) % capture.slots.size();
+    if(slot.job)
+    {
+        detail::wait(slot);
+        detail::map(capture, slot);
+    }
+
+    auto job = std::make_shared<CaptureJob>();
+    job->width = width;
+    job->height = height;
+    job->_encode = std::move(encode);
+
+    std::size_t size = 4 * std::size_t(width) * height;
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if(size > slot.capacity)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+
+    /* with a pack buffer bound the read only queues a copy on the GPU */
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(readBuffer);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glCheckError();
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.job = job;
+
+    return job;
+}
+
+bool captureUpdate(Capture &capture)
+{
+    /* oldest reads first, a read that isn't finished yet is checked again next frame */
+    for(std::size_t i = 0; i < capture.slots.size(); i++)
+    {
+        CaptureSlot& slot = capture.slots[(capture.next + i) % capture.slots.size()];
+        if(slot.job && detail::signaled(slot))
+        {
+            detail::map(capture, slot);
+        }
+    }
+
+    auto finished = [](const auto& job) { return detail::poll(*job); };
+    capture.encoding.erase(std::remove_if(capture.encoding.begin(), capture.encoding.end(), finished), capture.encoding.end());
+
+    bool reading = std::any_of(capture.slots.begin(), capture.slots.end(), [](const CaptureSlot& slot) { return slot.job != nullptr; });
+    return !reading && capture.encoding.empty();
+}
+
+void captureFinish(Capture &capture)
+{
+    for(std::size_t i = 0; i < capture.slots.size(); i++)
+    {
+        CaptureSlot& slot = capture.slots[(capture.next + i) % capture.slots.size()];
+        if(slot.job)
+        {
+            detail::wait(slot);
+            detail::map(capture, slot);
+        }
+    }
+
+    for(auto& job : capture.encoding)
+    {
+        threadPoolWait(capture.encoder, job->_encoded);
+        detail::poll(*job);
+    }
+    capture.encoding.clear();
+}
+
+void captureWritePNG(const CaptureJob &job)
+{
+    detail::checkPixels(job);
+
+    stbi_flip_vertically_on_write(true);
+    if(!stbi_write_png(job.path.c_str(), job.width, job.height, 4, job.pixels.data(), job.width * 4))
+    {
+        throw std::runtime_error("PNG encoder failed");
+    }
+}
+
+void captureWriteQOI(const CaptureJob &job)
+{
+    detail::checkPixels(job);
+
+    /* header: magic, size, 4 channels, sRGB */
+    std::vector<unsigned char> out = {'q', 'o', 'i', 'f'};
+    out.reserve(job.pixels.size() / 2);
+    detail::putBigEndian(out, job.width);
+    detail::putBigEndian(out, job.height);
+    out.push_back(4);
+    out.push_back(0);
+
+    /* runs of the previous pixel, pixels seen recently (by hash), small differences to the previous pixel */
+    unsigned char index[64][4] = {};
+    unsigned char previous[4] = {0, 0, 0, 255};
+    unsigned int run = 0;
+
+    std::size_t stride = 4 * std::size_t(job.width);
+    for(std::size_t y = job.height; y-- > 0;)
+    {
+        const unsigned char* row = job.pixels.data() + y * stride;
+        for(std::size_t x = 0; x < job.width; x++)
+        {
+            const unsigned char* px = row + 4 * x;
+            if(std::memcmp(px, previous, 4) == 0)
+            {
+                if(++run == 62)
+                {
+                    out.push_back(static_cast<unsigned char>(0xc0 | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if(run > 0)
+            {
+                out.push_back(static_cast<unsigned char>(0xc0 | (run - 1)));
+                run = 0;
+            }
+
+            int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+            if(std::memcmp(index[hash], px, 4) == 0)
+            {
+                out.push_back(static_cast<unsigned char>(hash));
+            }
+            else
+            {
+                std::memcpy(index[hash], px, 4);
+
+                if(px[3] == previous[3])
+                {
+                    int dr = static_cast<signed char>(px[0] - previous[0]);
+                    int dg = static_cast<signed char>(px[1] - previous[1]);
+                    int db = static_cast<signed char>(px[2] - previous[2]);
+                    int drg = dr - dg;
+                    int dbg = db - dg;
+
+                    if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        out.push_back(static_cast<unsigned char>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    }
+                    else if(dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+                    {
+                        out.push_back(static_cast<unsigned char>(0x80 | (dg + 32)));
+                        out.push_back(static_cast<unsigned char>((drg + 8) << 4 | (dbg + 8)));
+                    }
+                    else
+                    {
+                        out.insert(out.end(), {0xfe, px[0], px[1], px[2]});
+                    }
+                }
+                else
+                {
+                    out.insert(out.end(), {0xff, px[0], px[1], px[2], px[3]});
+                }
+            }
+            std::memcpy(previous, px, 4);
+        }
+    }
+    if(run > 0)
+    {
+        out.push_back(static_cast<unsigned char>(0xc0 | (run - 1)));
+    }
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+
+    std::ofstream file(job.path, std::ios::binary);
+    if(!file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size())))
+    {
+        throw std::runtime_error("couldn't write file");
+    }
+}
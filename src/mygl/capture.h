@@ -0,0 +1,137 @@
+#pragma once
+
+#include "base.h"
+#include "threadpool.h"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum eCaptureState { CaptureReading = 0, CaptureEncoding = 1, CaptureDone = 2, CaptureFailed = 3 };
+
+struct CaptureJob
+{
+    std::string path;
+    eCaptureState state = CaptureReading;
+    std::string error;
+
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    /* RGBA rows bottom to top (as read by OpenGL), only set while the job is encoded (empty if mapping failed) */
+    std::vector<unsigned char> pixels;
+
+    /* capture internals */
+    std::function<void(CaptureJob&)> _encode;
+    std::future<void> _encoded;
+};
+
+/* pixel buffer the frame of a job is read into, mapped once its fence is signaled */
+struct CaptureSlot
+{
+    GLuint pbo = 0;
+    std::size_t capacity = 0;
+    GLsync fence = nullptr;
+    std::shared_ptr<CaptureJob> job;
+};
+
+/* screenshots without stalling the render thread: glReadPixels goes into a ring of pixel buffer objects, the pixels
+   are copied out a frame or two later when the GPU is done with them and encoded to PNG on background threads */
+struct Capture
+{
+    std::vector<CaptureSlot> slots;
+    /* slot the next read goes into, slots are used in order so the oldest read is mapped first */
+    std::size_t next = 0;
+
+    ThreadPool* encoder = nullptr;
+    std::vector<std::shared_ptr<CaptureJob>> encoding;
+
+    /* backpressure: at most this many jobs wait for or run on the encoder (0 for no limit), reads beyond it wait for the
+       oldest job, counted in stalls */
+    std::size_t maxEncoding = 0;
+    std::size_t stalls = 0;
+};
+
+/**
+ * @brief Create the pixel buffer ring and the encoder threads of a capture.
+ *
+ * @param slots Number of reads that can be in flight (a read into a busy slot waits for it).
+ * @param encoderThreads Number of threads that encode images.
+ * @param maxEncoding Maximum number of jobs queued for the encoder (0 for no limit).
+ *
+ * @return Capture.
+ */
+Capture captureCreate(unsigned int slots = 3, unsigned int encoderThreads = 1, std::size_t maxEncoding = 0);
+
+/**
+ * @brief Finish all jobs, then delete pixel buffers and encoder threads. Has to be called for each capture after it is
+ * not used anymore.
+ *
+ * @param capture Capture to delete.
+ */
+void captureDelete(Capture& capture);
+
+/**
+ * @brief Start reading a rectangle of a framebuffer into the next pixel buffer. Returns immediately, the image is
+ * written to filepath by later calls of captureUpdate, as QOI if the path ends with .qoi and as PNG otherwise.
+ *
+ * @param capture Capture.
+ * @param framebuffer Framebuffer object to read (0 for the default framebuffer).
+ * @param readBuffer Color buffer to read, e.g. GL_BACK or GL_COLOR_ATTACHMENT0.
+ * @param width Width of the rectangle (starting at 0, 0).
+ * @param height Height of the rectangle.
+ * @param filepath Path to output image.
+ *
+ * @return Job that reports the progress of the capture.
+ */
+std::shared_ptr<CaptureJob> captureRead(Capture& capture, GLuint framebuffer, GLenum readBuffer, unsigned int width, unsigned int height, const std::string& filepath);
+
+/**
+ * @brief Start reading a rectangle of a framebuffer with a custom encoder. Jobs are handed to the encoder threads in
+ * the order they were read.
+ *
+ * @param capture Capture.
+ * @param framebuffer Framebuffer object to read (0 for the default framebuffer).
+ * @param readBuffer Color buffer to read, e.g. GL_BACK or GL_COLOR_ATTACHMENT0.
+ * @param width Width of the rectangle (starting at 0, 0).
+ * @param height Height of the rectangle.
+ * @param encode Called on an encoder thread with the pixels of the job, is called even if they couldn't be read (the
+ * pixels are empty then). Exceptions mark the job as failed.
+ *
+ * @return Job that reports the progress of the capture.
+ */
+std::shared_ptr<CaptureJob> captureRead(Capture& capture, GLuint framebuffer, GLenum readBuffer, unsigned int width, unsigned int height, std::function<void(CaptureJob&)> encode);
+
+/**
+ * @brief Write the pixels of a job as PNG to its path.
+ *
+ * @param job Job with pixels.
+ */
+void captureWritePNG(const CaptureJob& job);
+
+/**
+ * @brief Write the pixels of a job as QOI (lossless, encodes much faster than PNG) to its path.
+ *
+ * @param job Job with pixels.
+ */
+void captureWriteQOI(const CaptureJob& job);
+
+/**
+ * @brief Hand finished reads to the encoder and update the state of encoding jobs. Has to be called once per frame on
+ * the OpenGL thread, it doesn't wait for the GPU or the encoder.
+ *
+ * @param capture Capture.
+ *
+ * @return True if all jobs are finished.
+ */
+bool captureUpdate(Capture& capture);
+
+/**
+ * @brief Block until all jobs are finished.
+ *
+ * @param capture Capture.
+ */
+void captureFinish(Capture& capture);
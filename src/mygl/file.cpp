@@ -0,0 +1,165 @@
+#include "file.h"
+
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace detail
+{
+
+void mapError(const std::string& filepath)
+{
+    std::cerr << "[File] Couldn't map file at " << filepath << std::endl;
+    std::cerr.flush();
+    throw std::runtime_error("[File] Couldn't map file at " + filepath);
+}
+
+}
+
+std::uint64_t hashBytes(const char* data, std::size_t size)
+{
+    const std::uint64_t m0 = 0xff51afd7ed558ccdull;
+    const std::uint64_t m1 = 0xc4ceb9fe1a85ec53ull;
+
+    std::uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+    std::size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        std::uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        h = std::rotl(h ^ (w * m0), 31) * m1;
+    }
+
+    if(i < size)
+    {
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, data + i, size - i);
+        h = std::rotl(h ^ (tail * m0), 31) * m1;
+    }
+
+    h ^= h >> 33;
+    h *= m0;
+    h ^= h >> 33;
+    return h;
+}
+
+#ifdef _WIN32
+
+MappedFile mappedFileOpen(const std::string &filepath)
+{
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        detail::mapError(filepath);
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        detail::mapError(filepath);
+    }
+
+    MappedFile mapped;
+    mapped.size = static_cast<std::size_t>(size.QuadPart);
+
+    /* an empty file can't be mapped, but is still a valid file */
+    if(mapped.size == 0)
+    {
+        CloseHandle(file);
+        return mapped;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if(mapping == nullptr)
+    {
+        detail::mapError(filepath);
+    }
+
+    mapped.data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if(mapped.data == nullptr)
+    {
+        CloseHandle(mapping);
+        detail::mapError(filepath);
+    }
+
+    mapped._handle = mapping;
+    return mapped;
+}
+
+void mappedFileClose(MappedFile &file)
+{
+    if(file.data)
+    {
+        UnmapViewOfFile(file.data);
+        CloseHandle(file._handle);
+    }
+
+    file = MappedFile{};
+}
+
+#else
+
+MappedFile mappedFileOpen(const std::string &filepath)
+{
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        detail::mapError(filepath);
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        close(fd);
+        detail::mapError(filepath);
+    }
+
+    MappedFile mapped;
+    mapped.size = static_cast<std::size_t>(info.st_size);
+
+    /* an empty file can't be mapped, but is still a valid file */
+    if(mapped.size == 0)
+    {
+        close(fd);
+        return mapped;
+    }
+
+    void* data = mmap(nullptr, mapped.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        detail::mapError(filepath);
+    }
+
+    /* the parsers scan front to back, let the kernel read ahead aggressively */
+    madvise(data, mapped.size, MADV_SEQUENTIAL);
+
+    mapped.data = static_cast<const char*>(data);
+    return mapped;
+}
+
+void mappedFileClose(MappedFile &file)
+{
+    if(file.data)
+    {
+        munmap(const_cast<char*>(file.data), file.size);
+    }
+
+    file = MappedFile{};
+}
+
+#endif
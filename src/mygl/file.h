@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct MappedFile
+{
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    void* _handle = nullptr;
+};
+
+/**
+ * @brief Map a file read-only into memory. The content can be accessed through data/size without copying it.
+ *
+ * @param filepath Path to the file.
+ *
+ * @return Mapped file (data is nullptr for an empty file).
+ */
+MappedFile mappedFileOpen(const std::string& filepath);
+
+/**
+ * @brief Unmap a file mapped by mappedFileOpen. Has to be called for each mapped file after it is not used anymore.
+ *
+ * @param file Mapped file to close.
+ */
+void mappedFileClose(MappedFile& file);
+
+/**
+ * @brief Fast non-cryptographic 64 bit hash, used to detect changed files and as cache key.
+ *
+ * @param data Pointer to size bytes.
+ * @param size Number of bytes.
+ *
+ * @return Hash value.
+ */
+std::uint64_t hashBytes(const char* data, std::size_t size);
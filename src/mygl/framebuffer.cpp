@@ -1,8 +1,13 @@
 #include "framebuffer.h"
 
+#include "glstate.h"
+
 #include <cassert>
 #include <stdexcept>
 #include <iostream>
+#include <vector>
+
+#include <stb_image/stb_image_write.h>
 
 Framebuffer framebufferCreate(unsigned int width, unsigned int height)
 {
@@ -15,9 +20,10 @@ Framebuffer framebufferCreate(unsigned int width, unsigned int height)
     /* create color attachment */
     GLuint colorTexture;
     glGenTextures(1, &colorTexture);
-    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    stateBindTexture(GL_TEXTURE_2D, colorTexture);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    /* RGBA matches the format the color is read back in, so the read doesn't have to convert */
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -27,7 +33,7 @@ Framebuffer framebufferCreate(unsigned int width, unsigned int height)
     /* create depth/stencil attachment */
     GLuint depthTexture;
     glGenTextures(1, &depthTexture);
-    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    stateBindTexture(GL_TEXTURE_2D, depthTexture);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
 
@@ -51,13 +57,27 @@ Framebuffer framebufferCreate(unsigned int width, unsigned int height)
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 
-    return {fbo, colorTexture, depthTexture};
+    return {fbo, colorTexture, depthTexture, width, height};
 }
 
 void framebufferDelete(const Framebuffer &fb)
 {
     glDeleteTextures(1, &fb.colorTex);
     glDeleteTextures(1, &fb.depthTex);
+    stateInvalidate();
     glDeleteFramebuffers(1, &fb.fbo);
     glCheckError();
 }
+
+void framebufferToPNG(const Framebuffer &fb, const std::string &filepath)
+{
+    std::vector<GLubyte> data(4 * std::size_t(fb.width) * fb.height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fb.fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, fb.width, fb.height, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+    glCheckError();
+
+    stbi_flip_vertically_on_write(true);
+    stbi_write_png(filepath.c_str(), fb.width, fb.height, 4, data.data(), fb.width * 4);
+}
@@ -7,6 +7,9 @@ struct Framebuffer
     GLuint fbo = 0;
     GLuint colorTex = 0;
     GLuint depthTex = 0;
+
+    unsigned int width = 0;
+    unsigned int height = 0;
 };
 
 /**
@@ -24,3 +27,11 @@ Framebuffer framebufferCreate(unsigned int width, unsigned int height);
  * @param fb Framebuffer to delete.
  */
 void framebufferDelete(const Framebuffer& fb);
+
+/**
+ * @brief Save the color attachment of a framebuffer as PNG image (screenshotToPNG for offscreen rendering).
+ *
+ * @param fb Framebuffer to read.
+ * @param filepath Path to output image.
+ */
+void framebufferToPNG(const Framebuffer& fb, const std::string& filepath);
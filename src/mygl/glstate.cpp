@@ -0,0 +1,193 @@
+#include "glstate.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace detail
+{
+
+/* last value of a uniform location, large enough for a mat4 */
+struct UniformValue
+{
+    std::size_t size = 0;
+    std::array<unsigned char, 16 * sizeof(float)> data;
+};
+
+/* shadow copy of the GL state of the (single) context, unknown entries are not in the maps */
+struct State
+{
+    bool programValid = false;
+    GLuint program = 0;
+    bool vaoValid = false;
+    GLuint vao = 0;
+    bool activeTextureValid = false;
+    GLenum activeTexture = GL_TEXTURE0;
+
+    std::unordered_map<GLenum, GLuint> buffers;
+    /* key is (texture unit << 32) | target */
+    std::unordered_map<std::uint64_t, GLuint> textures;
+    std::unordered_map<GLenum, bool> capabilities;
+    std::unordered_map<GLuint, std::unordered_map<GLint, UniformValue>> uniforms;
+
+    StateCounters frame;
+    StateCounters last;
+};
+
+State state;
+
+/* returns true if the call has to be issued */
+bool bind(bool& valid, GLuint& current, GLuint value)
+{
+    if(valid && current == value)
+    {
+        state.frame.bindsSkipped++;
+        return false;
+    }
+
+    valid = true;
+    current = value;
+    state.frame.binds++;
+    return true;
+}
+
+template<typename Map, typename Key, typename Value>
+bool bind(Map& map, const Key& key, const Value& value)
+{
+    auto it = map.find(key);
+    if(it != map.end() && it->second == value)
+    {
+        state.frame.bindsSkipped++;
+        return false;
+    }
+
+    map[key] = value;
+    state.frame.binds++;
+    return true;
+}
+
+}
+
+void stateUseProgram(GLuint program)
+{
+    if(detail::bind(detail::state.programValid, detail::state.program, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+void stateBindVertexArray(GLuint vao)
+{
+    if(detail::bind(detail::state.vaoValid, detail::state.vao, vao))
+    {
+        glBindVertexArray(vao);
+    }
+}
+
+void stateBindBuffer(GLenum target, GLuint buffer)
+{
+    if(target == GL_ELEMENT_ARRAY_BUFFER)
+    {
+        glBindBuffer(target, buffer);
+        return;
+    }
+
+    if(detail::bind(detail::state.buffers, target, buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void stateBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    glBindBufferBase(target, index, buffer);
+    detail::state.buffers[target] = buffer;
+    detail::state.frame.binds++;
+}
+
+void stateActiveTexture(GLenum unit)
+{
+    if(detail::bind(detail::state.activeTextureValid, detail::state.activeTexture, unit))
+    {
+        glActiveTexture(unit);
+    }
+}
+
+void stateBindTexture(GLenum target, GLuint texture)
+{
+    /* without a known active unit the binding can't be attributed to a unit */
+    if(!detail::state.activeTextureValid)
+    {
+        stateActiveTexture(GL_TEXTURE0);
+    }
+
+    std::uint64_t key = (std::uint64_t(detail::state.activeTexture) << 32) | target;
+    if(detail::bind(detail::state.textures, key, texture))
+    {
+        glBindTexture(target, texture);
+    }
+}
+
+void stateEnable(GLenum capability, bool enabled)
+{
+    if(detail::bind(detail::state.capabilities, capability, enabled))
+    {
+        if(enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+}
+
+bool stateUniform(GLint location, const void *data, std::size_t size)
+{
+    /* uniforms of an unknown program or inactive uniforms can't be tracked */
+    if(!detail::state.programValid || location < 0 || size > sizeof(detail::UniformValue::data))
+    {
+        detail::state.frame.uniforms++;
+        return true;
+    }
+
+    detail::UniformValue& value = detail::state.uniforms[detail::state.program][location];
+    if(value.size == size && std::memcmp(value.data.data(), data, size) == 0)
+    {
+        detail::state.frame.uniformsSkipped++;
+        return false;
+    }
+
+    value.size = size;
+    std::memcpy(value.data.data(), data, size);
+    detail::state.frame.uniforms++;
+    return true;
+}
+
+void stateForgetProgram(GLuint program)
+{
+    detail::state.uniforms.erase(program);
+    if(detail::state.program == program)
+    {
+        detail::state.programValid = false;
+    }
+}
+
+void stateInvalidate()
+{
+    detail::state.programValid = false;
+    detail::state.vaoValid = false;
+    detail::state.activeTextureValid = false;
+    detail::state.buffers.clear();
+    detail::state.textures.clear();
+    detail::state.capabilities.clear();
+}
+
+void stateNewFrame()
+{
+    detail::state.last = detail::state.frame;
+    detail::state.frame = StateCounters{};
+}
+
+StateCounters stateCounters()
+{
+    return detail::state.last;
+}
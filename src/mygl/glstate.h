@@ -0,0 +1,105 @@
+#pragma once
+
+#include "base.h"
+
+/* GL calls issued and skipped because the value was already set, counted per frame */
+struct StateCounters
+{
+    unsigned int binds = 0;
+    unsigned int bindsSkipped = 0;
+    unsigned int uniforms = 0;
+    unsigned int uniformsSkipped = 0;
+};
+
+/**
+ * @brief Bind a program with glUseProgram, unless it is already in use.
+ *
+ * @param program Program name, 0 to unbind.
+ */
+void stateUseProgram(GLuint program);
+
+/**
+ * @brief Bind a vertex array object, unless it is already bound.
+ *
+ * @param vao Vertex array name, 0 to unbind.
+ */
+void stateBindVertexArray(GLuint vao);
+
+/**
+ * @brief Bind a buffer to a (non indexed) target, unless it is already bound. GL_ELEMENT_ARRAY_BUFFER is part of the
+ * vertex array state and is not tracked, it is always bound directly with glBindBuffer.
+ *
+ * @param target Buffer target, e.g. GL_ARRAY_BUFFER or GL_UNIFORM_BUFFER.
+ * @param buffer Buffer name, 0 to unbind.
+ */
+void stateBindBuffer(GLenum target, GLuint buffer);
+
+/**
+ * @brief Bind a buffer to an indexed binding point with glBindBufferBase. The call is always issued, but it also binds
+ * the buffer to the generic target, which is recorded.
+ *
+ * @param target Indexed buffer target, e.g. GL_UNIFORM_BUFFER.
+ * @param index Binding point.
+ * @param buffer Buffer name.
+ */
+void stateBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+/**
+ * @brief Select the active texture unit, unless it is already active.
+ *
+ * @param unit Texture unit, e.g. GL_TEXTURE0.
+ */
+void stateActiveTexture(GLenum unit);
+
+/**
+ * @brief Bind a texture to the active texture unit, unless it is already bound there.
+ *
+ * @param target Texture target, e.g. GL_TEXTURE_2D.
+ * @param texture Texture name, 0 to unbind.
+ */
+void stateBindTexture(GLenum target, GLuint texture);
+
+/**
+ * @brief Enable or disable a capability with glEnable / glDisable, unless it already has that state.
+ *
+ * @param capability Capability, e.g. GL_DEPTH_TEST.
+ * @param enabled New state.
+ */
+void stateEnable(GLenum capability, bool enabled = true);
+
+/**
+ * @brief Compare a uniform value with the last value written to the same location of the program in use and remember
+ * it. Used by the shaderUniform functions, which only call glUniform* if this returns true.
+ *
+ * @param location Uniform location in the current program.
+ * @param data Value of the uniform.
+ * @param size Size of the value in bytes (at most a 4x4 matrix).
+ *
+ * @return True if the value differs from the last one and has to be uploaded.
+ */
+bool stateUniform(GLint location, const void* data, std::size_t size);
+
+/**
+ * @brief Forget the uniform values of a program, has to be called when the program is deleted (the name can be reused).
+ *
+ * @param program Program name.
+ */
+void stateForgetProgram(GLuint program);
+
+/**
+ * @brief Forget all bindings, e.g. after objects were deleted (GL unbinds deleted objects and names are reused) or
+ * after code that does not go through the state cache changed bindings. Uniform values are kept.
+ */
+void stateInvalidate();
+
+/**
+ * @brief Finish a frame: the counters of the frame become available through stateCounters and counting starts at 0.
+ */
+void stateNewFrame();
+
+/**
+ * @brief Counters of the last finished frame.
+ *
+ * @return Issued and skipped binds and uniform uploads.
+ */
+StateCounters stateCounters();
@@ -0,0 +1,140 @@
+#include "grid.h"
+
+#include "glstate.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace detail
+{
+
+/* cells of cellSize starting at origin */
+Mesh cellMesh(GLuint vao, const Vector3D& origin, float cellSize)
+{
+    Mesh mesh;
+    mesh.vao = vao;
+    mesh.positionOffset = origin;
+    mesh.positionScale = {cellSize, 1.0f, cellSize};
+    return mesh;
+}
+
+/* one triangle strip of 2 (width + 1) vertices per row of width cells */
+Material stripMaterial(const Material& material, unsigned int width)
+{
+    Material strip = material;
+    strip.indexOffset = 0;
+    strip.indexCount = 2 * (width + 1);
+    return strip;
+}
+
+float levelCellSize(const Clipmap& clipmap, unsigned int level)
+{
+    return std::ldexp(clipmap.cellSize, static_cast<int>(level));
+}
+
+/* corner of a level, snapped to two cells of the level */
+Vector3D levelOrigin(const Clipmap& clipmap, unsigned int level, const Vector3D& center)
+{
+    float cell = levelCellSize(clipmap, level);
+    float half = 0.5f * float(clipmap.resolution) * cell;
+    return {std::floor(center.x / (2.0f * cell)) * 2.0f * cell - half, 0.0f,
+            std::floor(center.z / (2.0f * cell)) * 2.0f * cell - half};
+}
+
+}
+
+Clipmap clipmapCreate(unsigned int resolution, unsigned int levels, float cellSize)
+{
+    Clipmap clipmap;
+    glGenVertexArrays(1, &clipmap.vao);
+    glCheckError();
+
+    clipmap.cellSize = cellSize;
+    clipmapResize(clipmap, resolution, levels);
+    return clipmap;
+}
+
+void clipmapResize(Clipmap &clipmap, unsigned int resolution, unsigned int levels)
+{
+    clipmap.resolution = std::max((resolution + 3) / 4 * 4, clipmapMinResolution);
+    clipmap.levels = std::max(levels, 1u);
+    clipmap.blocks.clear();
+}
+
+void clipmapDelete(Clipmap &clipmap)
+{
+    glDeleteVertexArrays(1, &clipmap.vao);
+    stateInvalidate();
+    clipmap = Clipmap{};
+}
+
+float clipmapExtent(const Clipmap &clipmap)
+{
+    return 0.5f * float(clipmap.resolution) * detail::levelCellSize(clipmap, clipmap.levels - 1);
+}
+
+void clipmapUpdate(Clipmap &clipmap, const Vector3D &center)
+{
+    clipmap.blocks.clear();
+
+    unsigned int n = clipmap.resolution;
+    Vector3D finest = detail::levelOrigin(clipmap, 0, center);
+    clipmap.blocks.push_back(ClipmapBlock{0, finest, n, n, detail::cellMesh(clipmap.vao, finest, clipmap.cellSize)});
+
+    for(unsigned int level = 1; level < clipmap.levels; level++)
+    {
+        float cell = detail::levelCellSize(clipmap, level);
+        Vector3D origin = detail::levelOrigin(clipmap, level, center);
+        Vector3D inner = detail::levelOrigin(clipmap, level - 1, center);
+
+        /* the inner level covers n / 2 cells starting at cell n / 4 or n / 4 + 1 (depending on the snapping) */
+        auto hx = static_cast<unsigned int>(std::lround((inner.x - origin.x) / cell));
+        auto hz = static_cast<unsigned int>(std::lround((inner.z - origin.z) / cell));
+        unsigned int hole = n / 2;
+
+        auto block = [&](unsigned int x, unsigned int z, unsigned int width, unsigned int height) {
+            Vector3D corner = origin + Vector3D(float(x) * cell, 0.0f, float(z) * cell);
+            clipmap.blocks.push_back(ClipmapBlock{level, corner, width, height, detail::cellMesh(clipmap.vao, corner, cell)});
+        };
+
+        /* full rows below and above the hole, the rest of the rows left and right of it */
+        block(0, 0, n, hz);
+        block(0, hz + hole, n, n - hz - hole);
+        block(0, hz, hx, hole);
+        block(hx + hole, hz, n - hx - hole, hole);
+    }
+}
+
+Vector2D clipmapMorph(const Clipmap &clipmap)
+{
+    /* the border of a level is between n / 2 - 2 and n / 2 + 2 cells from the camera, depending on the snapping, all
+       vertices from n / 2 - 2 on are completely morphed. The inner border of a level is at most n / 4 + 1 cells away
+       and must not move, for n >= 32 the morph starts behind it. */
+    float end = 0.5f * float(clipmap.resolution) - 2.0f;
+    return {end - 0.125f * float(clipmap.resolution), end};
+}
+
+unsigned int clipmapPush(RenderQueue &queue, Clipmap &clipmap, const Material &material, ShaderProgram &program, float displacement, ShaderProgram *depthProgram, unsigned int layer)
+{
+    unsigned int count = 0;
+    for(auto& block : clipmap.blocks)
+    {
+        if(block.width == 0 || block.height == 0)
+        {
+            continue;
+        }
+
+        float cell = detail::levelCellSize(clipmap, block.level);
+        Bounds bounds;
+        bounds.min = block.origin - Vector3D(0.0f, displacement, 0.0f);
+        bounds.max = block.origin + Vector3D(float(block.width) * cell, displacement, float(block.height) * cell);
+        bounds.center = 0.5f * (bounds.min + bounds.max);
+        bounds.radius = length(bounds.max - bounds.center);
+
+        block.material = detail::stripMaterial(material, block.width);
+        renderQueuePushArrays(queue, program, block.mesh, block.material, GL_TRIANGLE_STRIP, block.height, bounds, depthProgram, layer);
+        count++;
+    }
+
+    return count;
+}
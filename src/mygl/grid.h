@@ -0,0 +1,117 @@
+#pragma once
+
+#include "batch.h"
+#include "renderqueue.h"
+
+#include <vector>
+
+/* smallest resolution of a clipmap, the morph area of a level has to stay outside of the level inside it */
+constexpr unsigned int clipmapMinResolution = 32;
+
+/* rectangle of cells of one clipmap level */
+struct ClipmapBlock
+{
+    unsigned int level = 0;
+
+    /* corner with the smallest x and z, size in cells of the level */
+    Vector3D origin;
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    /* draw of the block: the mesh maps cells to world space, the material holds the vertex range of a row (set by
+       clipmapPush, the render queue references both) */
+    Mesh mesh;
+    Material material;
+};
+
+/* nested grids around a center (geometry clipmap, Losasso/Hoppe): every level has resolution x resolution cells of
+   twice the size of the level inside it and leaves out the area that level covers. Levels move in steps of two of their
+   cells, so their vertices stay on the grid of the next coarser level. Programs compiled with GRID and CLIPMAP move the
+   odd vertices near the border of a level onto the coarser grid, which closes the seams between the levels. The blocks
+   have no vertex or index data, programs compiled with GRID generate the vertices: every instance is one row of cells
+   drawn as a triangle strip, gl_VertexID walks along the row. */
+struct Clipmap
+{
+    /* empty vertex array shared by all blocks */
+    GLuint vao = 0;
+
+    /* cells per side of every level (multiple of 4, at least clipmapMinResolution) */
+    unsigned int resolution = 0;
+    unsigned int levels = 0;
+    /* cell size of the finest level */
+    float cellSize = 0.0f;
+
+    /* blocks of all levels for the center of the last clipmapUpdate */
+    std::vector<ClipmapBlock> blocks;
+};
+
+/**
+ * @brief Create a clipmap, clipmapUpdate has to be called before it is drawn.
+ *
+ * @param resolution Cells per side of every level, rounded up to a multiple of 4 (at least clipmapMinResolution).
+ * @param levels Number of levels.
+ * @param cellSize Cell size of the finest level.
+ *
+ * @return Clipmap.
+ */
+Clipmap clipmapCreate(unsigned int resolution, unsigned int levels, float cellSize);
+
+/**
+ * @brief Change resolution and number of levels (the blocks are updated with the next clipmapUpdate).
+ *
+ * @param clipmap Clipmap.
+ * @param resolution Cells per side of every level, rounded up to a multiple of 4 (at least clipmapMinResolution).
+ * @param levels Number of levels.
+ */
+void clipmapResize(Clipmap& clipmap, unsigned int resolution, unsigned int levels);
+
+/**
+ * @brief Delete the vertex array of a clipmap.
+ *
+ * @param clipmap Clipmap to delete.
+ */
+void clipmapDelete(Clipmap& clipmap);
+
+/**
+ * @brief Half the side length of the area covered by all levels.
+ *
+ * @param clipmap Clipmap.
+ *
+ * @return Extent of the coarsest level.
+ */
+float clipmapExtent(const Clipmap& clipmap);
+
+/**
+ * @brief Move the levels to a new center (only x and z are used) and rebuild the blocks.
+ *
+ * @param clipmap Clipmap.
+ * @param center Camera position (the vertex shader morphs relative to the camera of the frame).
+ */
+void clipmapUpdate(Clipmap& clipmap, const Vector3D& center);
+
+/**
+ * @brief Distance (in cells of a level, from the center, maximum norm) where morphing to the coarser level starts and
+ * where it is complete. Has to be passed to the program as uGridMorph.
+ *
+ * @param clipmap Clipmap.
+ *
+ * @return Start and end of the morph.
+ */
+Vector2D clipmapMorph(const Clipmap& clipmap);
+
+/**
+ * @brief Push all blocks to a render queue as triangle strips that are culled and sorted with the other items. The
+ * blocks are placed in world space and referenced by the queue, the clipmap must not be updated before the last
+ * renderQueueSubmit of the frame.
+ *
+ * @param queue Render queue.
+ * @param clipmap Clipmap.
+ * @param material Surface material (its index range is ignored).
+ * @param program Shader program compiled with GRID and CLIPMAP.
+ * @param displacement Largest vertical displacement of the surface in the vertex shader (e.g. wave amplitudes).
+ * @param depthProgram Shader program of depth-only submits, nullptr to leave the blocks out of them.
+ * @param layer Render queue layer of the blocks (see RenderItem).
+ *
+ * @return Number of blocks pushed.
+ */
+unsigned int clipmapPush(RenderQueue& queue, Clipmap& clipmap, const Material& material, ShaderProgram& program, float displacement, ShaderProgram* depthProgram = nullptr, unsigned int layer = 0);
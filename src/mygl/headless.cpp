@@ -0,0 +1,122 @@
+#include "headless.h"
+
+#include <iostream>
+
+#ifdef HEADLESS_EGL
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+namespace detail
+{
+
+bool hasExtension(const char* extensions, const char* name)
+{
+    return extensions != nullptr && std::strstr(extensions, name) != nullptr;
+}
+
+/* Mesa's surfaceless platform needs neither X nor a GPU device, other drivers get their default display */
+EGLDisplay display()
+{
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if(hasExtension(extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if(getPlatformDisplay != nullptr)
+        {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if(display != EGL_NO_DISPLAY)
+            {
+                return display;
+            }
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+}
+
+HeadlessContext headlessCreate()
+{
+    EGLDisplay display = detail::display();
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        std::cerr << "Couldn't initialize EGL" << std::endl;
+        return {};
+    }
+
+    /* a config is only needed for surfaces, the context is never bound to one */
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    if(!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+    {
+        config = nullptr;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = EGL_NO_CONTEXT;
+    if(eglBindAPI(EGL_OPENGL_API))
+    {
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    }
+    if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        std::cerr << "Couldn't create headless GL context" << std::endl;
+        if(context != EGL_NO_CONTEXT)
+        {
+            eglDestroyContext(display, context);
+        }
+        eglTerminate(display);
+        return {};
+    }
+
+    HeadlessContext headless{display, context};
+
+    /*-------------- init glad ----------------*/
+    if(!gladLoadGLLoader((GLADloadproc) eglGetProcAddress))
+    {
+        std::cerr << "Couldn't initialize GLAD" << std::endl;
+        headlessDelete(headless);
+        return {};
+    }
+    glLoadCore33((GLADloadproc) eglGetProcAddress);
+
+    return headless;
+}
+
+void headlessDelete(HeadlessContext &context)
+{
+    if(context.display != nullptr)
+    {
+        eglMakeCurrent(context.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if(context.context != nullptr)
+        {
+            eglDestroyContext(context.display, context.context);
+        }
+        eglTerminate(context.display);
+    }
+    context = HeadlessContext{};
+}
+
+#else
+
+HeadlessContext headlessCreate()
+{
+    std::cerr << "Headless rendering isn't available, build with BUILD_HEADLESS" << std::endl;
+    return {};
+}
+
+void headlessDelete(HeadlessContext &context)
+{
+    context = HeadlessContext{};
+}
+
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "base.h"
+
+/* OpenGL context without a window or display server: EGL on a surfaceless display (e.g. Mesa llvmpipe on a server).
+   There is no default framebuffer, everything has to be rendered into framebuffer objects. Only available if built with
+   BUILD_HEADLESS (defines HEADLESS_EGL), otherwise headlessCreate fails. */
+struct HeadlessContext
+{
+    /* EGLDisplay and EGLContext, nullptr if the context couldn't be created */
+    void* display = nullptr;
+    void* context = nullptr;
+};
+
+/**
+ * @brief Create an OpenGL 3.3 core context without a window, make it current and initialize GLAD.
+ *
+ * @return Headless context (context is nullptr on failure).
+ */
+HeadlessContext headlessCreate();
+/**
+ * @brief Delete a headless context. Has to be called for each context after it is not used anymore.
+ *
+ * @param context Headless context to delete.
+ */
+void headlessDelete(HeadlessContext& context);
@@ -0,0 +1,201 @@
+#include "lightgrid.h"
+
+#include "glstate.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace detail
+{
+
+constexpr GLenum textureFormats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+constexpr const char* samplerNames[3] = {"uLights", "uClusters", "uClusterLights"};
+
+/* reallocate (orphan) the buffer every frame, so the driver doesn't wait for draws of the last frame */
+void upload(GLuint buffer, std::size_t& capacity, const void* data, std::size_t size)
+{
+    capacity = std::max(capacity, size);
+    stateBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+/* tile range [first, last] covered by the view space interval [low, high] seen at depths [depthNear, depthFar] */
+bool tileRange(float low, float high, float depthNear, float depthFar, float projection, unsigned int tiles, unsigned int& first, unsigned int& last)
+{
+    /* x / depth is smallest for the nearest depth if x is negative and for the farthest if it is positive */
+    float ndcLow = projection * low / (low < 0.0f ? depthNear : depthFar);
+    float ndcHigh = projection * high / (high > 0.0f ? depthNear : depthFar);
+    if(ndcHigh < -1.0f || ndcLow > 1.0f)
+    {
+        return false;
+    }
+
+    auto tile = [&](float ndc) {
+        return static_cast<unsigned int>(std::clamp((0.5f * ndc + 0.5f) * float(tiles), 0.0f, float(tiles - 1)));
+    };
+    first = tile(ndcLow);
+    last = tile(ndcHigh);
+    return true;
+}
+
+}
+
+float lightRange(const Vector3D &color, float threshold)
+{
+    /* solve 0.1 d^2 + 0.2 d + 1 = intensity / threshold */
+    float intensity = std::max({color.x, color.y, color.z});
+    float c = 1.0f - intensity / threshold;
+    if(c >= 0.0f)
+    {
+        return 0.0f;
+    }
+    return (-0.2f + std::sqrt(0.04f - 0.4f * c)) / 0.2f;
+}
+
+LightGrid lightGridCreate(unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ)
+{
+    LightGrid grid;
+    grid.sizeX = sizeX;
+    grid.sizeY = sizeY;
+    grid.sizeZ = sizeZ;
+
+    glGenBuffers(3, grid.buffers);
+    glGenTextures(3, grid.textures);
+    for(int i = 0; i < 3; i++)
+    {
+        stateBindTexture(GL_TEXTURE_BUFFER, grid.textures[i]);
+        stateBindBuffer(GL_TEXTURE_BUFFER, grid.buffers[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, detail::textureFormats[i], grid.buffers[i]);
+    }
+    stateBindBuffer(GL_TEXTURE_BUFFER, 0);
+    stateBindTexture(GL_TEXTURE_BUFFER, 0);
+    glCheckError();
+
+    return grid;
+}
+
+void lightGridDelete(LightGrid &grid)
+{
+    glDeleteTextures(3, grid.textures);
+    glDeleteBuffers(3, grid.buffers);
+    stateInvalidate();
+    grid = LightGrid{};
+}
+
+void lightGridClear(LightGrid &grid)
+{
+    grid.lights.clear();
+}
+
+void lightGridAdd(LightGrid &grid, const Light &light)
+{
+    if(light.range > 0.0f)
+    {
+        grid.lights.push_back(light);
+    }
+}
+
+void lightGridBuild(LightGrid &grid, const Camera &camera)
+{
+    Matrix4D view = cameraView(camera);
+    Matrix4D projection = cameraProjection(camera);
+
+    /* slice k covers the view depths n * (f / n)^(k / sizeZ) to n * (f / n)^((k + 1) / sizeZ) */
+    float nearPlane = camera.nearPlane;
+    float farPlane = camera.farPlane;
+    float sliceScale = float(grid.sizeZ) / std::log(farPlane / nearPlane);
+    grid.scale = Vector4D(float(grid.sizeX) / camera.width, float(grid.sizeY) / camera.height, sliceScale, -std::log(nearPlane) * sliceScale);
+    auto sliceDepth = [&](unsigned int slice) { return nearPlane * std::pow(farPlane / nearPlane, float(slice) / float(grid.sizeZ)); };
+
+    /* the clusters touched by every light, as (cluster, light) pairs counted per cluster */
+    std::size_t clusterCount = std::size_t(grid.sizeX) * grid.sizeY * grid.sizeZ;
+    std::vector<unsigned int> counts(clusterCount, 0);
+    std::vector<std::pair<unsigned int, unsigned int>> pairs;
+
+    for(std::size_t i = 0; i < grid.lights.size(); i++)
+    {
+        const Light& light = grid.lights[i];
+        Vector4D center = view * Vector4D(light.position, 1.0f);
+        float r = light.range;
+        float depth = -center.z;
+
+        float depthNear = std::max(depth - r, nearPlane);
+        float depthFar = std::min(depth + r, farPlane);
+        if(depthNear > depthFar)
+        {
+            continue;
+        }
+
+        auto slice = [&](float d) {
+            return static_cast<unsigned int>(std::clamp(std::log(d) * sliceScale + grid.scale.w, 0.0f, float(grid.sizeZ - 1)));
+        };
+
+        for(unsigned int z = slice(depthNear); z <= slice(depthFar); z++)
+        {
+            /* tiles are bounded per slice by the part of the sphere in the slice */
+            float zNear = std::max(depthNear, sliceDepth(z));
+            float zFar = std::min(depthFar, sliceDepth(z + 1));
+
+            unsigned int x0, x1, y0, y1;
+            if(!detail::tileRange(center.x - r, center.x + r, zNear, zFar, projection(0, 0), grid.sizeX, x0, x1) ||
+               !detail::tileRange(center.y - r, center.y + r, zNear, zFar, projection(1, 1), grid.sizeY, y0, y1))
+            {
+                continue;
+            }
+
+            for(unsigned int y = y0; y <= y1; y++)
+            {
+                for(unsigned int x = x0; x <= x1; x++)
+                {
+                    unsigned int cluster = x + grid.sizeX * (y + grid.sizeY * z);
+                    counts[cluster]++;
+                    pairs.emplace_back(cluster, static_cast<unsigned int>(i));
+                }
+            }
+        }
+    }
+
+    /* prefix sum of the counts gives the ranges, the pairs are scattered into them */
+    grid.clusters.resize(2 * clusterCount);
+    unsigned int offset = 0;
+    for(std::size_t c = 0; c < clusterCount; c++)
+    {
+        grid.clusters[2 * c] = offset;
+        grid.clusters[2 * c + 1] = 0;
+        offset += counts[c];
+    }
+
+    grid.indices.resize(pairs.size());
+    for(const auto& [cluster, light] : pairs)
+    {
+        grid.indices[grid.clusters[2 * cluster] + grid.clusters[2 * cluster + 1]++] = light;
+    }
+
+    std::vector<Vector4D> data;
+    data.reserve(lightDataTexels * grid.lights.size());
+    for(const auto& light : grid.lights)
+    {
+        data.push_back(Vector4D(light.color, light.range));
+        data.push_back(Vector4D(light.position, light.cosCutoff));
+        data.push_back(Vector4D(normalize(light.direction), 0.0f));
+    }
+
+    detail::upload(grid.buffers[0], grid.capacities[0], data.data(), data.size() * sizeof(Vector4D));
+    detail::upload(grid.buffers[1], grid.capacities[1], grid.clusters.data(), grid.clusters.size() * sizeof(unsigned int));
+    detail::upload(grid.buffers[2], grid.capacities[2], grid.indices.data(), grid.indices.size() * sizeof(unsigned int));
+    glCheckError();
+}
+
+void lightGridBind(const LightGrid &grid, ShaderProgram &shader)
+{
+    for(unsigned int i = 0; i < 3; i++)
+    {
+        stateActiveTexture(GL_TEXTURE0 + lightGridTextureUnit + i);
+        stateBindTexture(GL_TEXTURE_BUFFER, grid.textures[i]);
+        shaderUniform(shader, detail::samplerNames[i], static_cast<int>(lightGridTextureUnit + i));
+    }
+
+    shaderUniform(shader, "uClusterScale", grid.scale);
+    shaderUniform(shader, "uClusterSize", Vector3D(float(grid.sizeX), float(grid.sizeY), float(grid.sizeZ)));
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "camera.h"
+#include "shader.h"
+
+#include <vector>
+
+/* number of RGBA32F texels per light: color and range, position and cosine of the cutoff angle, direction */
+constexpr unsigned int lightDataTexels = 3;
+
+/* texture units the light grid is bound to (units 0 and 1 are used by draw and instance data, see batch.h) */
+constexpr unsigned int lightGridTextureUnit = 2;
+
+/* spot light (a cutoff angle of 180 degrees makes it a point light) */
+struct Light
+{
+    Vector3D color;
+    Vector3D position;
+    Vector3D direction;
+    float cosCutoff = -1.0f;
+
+    /* distance at which the (windowed) attenuation reaches zero, see lightRange */
+    float range = 0.0f;
+};
+
+/* clustered forward lighting: the view frustum is divided into tiles on screen and exponential slices in depth
+   (froxels), every cluster has a list of the lights whose range touches it */
+struct LightGrid
+{
+    /* clusters in x, y (screen tiles) and z (depth slices) */
+    unsigned int sizeX = 0;
+    unsigned int sizeY = 0;
+    unsigned int sizeZ = 0;
+
+    std::vector<Light> lights;
+
+    /* range of each cluster in indices (offset, count) and the concatenated light indices of all clusters */
+    std::vector<unsigned int> clusters;
+    std::vector<unsigned int> indices;
+
+    /* pixels to tiles (x, y) and view depth to slice (slice = log(depth) * z + w) of the last lightGridBuild */
+    Vector4D scale;
+
+    /* buffer textures: lights (RGBA32F), cluster ranges (RG32UI), light indices (R32UI) */
+    GLuint buffers[3] = {0, 0, 0};
+    GLuint textures[3] = {0, 0, 0};
+    std::size_t capacities[3] = {0, 0, 0};
+};
+
+/**
+ * @brief Distance at which the attenuation of the shaders (1 / (1 + 0.2 d + 0.1 d^2)) times the brightest channel of
+ * the color drops below a threshold. The clustered shader fades the light out towards this distance.
+ *
+ * @param color Light color.
+ * @param threshold Smallest contribution that is still considered.
+ *
+ * @return Range of the light.
+ */
+float lightRange(const Vector3D& color, float threshold = 1.0f / 64.0f);
+
+/**
+ * @brief Create an empty light grid with its buffer textures.
+ *
+ * @param sizeX Number of tiles in x.
+ * @param sizeY Number of tiles in y.
+ * @param sizeZ Number of depth slices.
+ *
+ * @return Light grid.
+ */
+LightGrid lightGridCreate(unsigned int sizeX = 16, unsigned int sizeY = 9, unsigned int sizeZ = 24);
+
+/**
+ * @brief Delete the buffer textures of a light grid.
+ *
+ * @param grid Light grid to delete.
+ */
+void lightGridDelete(LightGrid& grid);
+
+/**
+ * @brief Remove all lights (done once per frame before the lights are added again).
+ *
+ * @param grid Light grid.
+ */
+void lightGridClear(LightGrid& grid);
+
+/**
+ * @brief Add a light in world space.
+ *
+ * @param grid Light grid.
+ * @param light Light, lights without range are ignored.
+ */
+void lightGridAdd(LightGrid& grid, const Light& light);
+
+/**
+ * @brief Assign the lights to the clusters of the view frustum of a camera and upload lights and cluster lists.
+ *
+ * @param grid Light grid.
+ * @param camera Camera of the frame.
+ */
+void lightGridBuild(LightGrid& grid, const Camera& camera);
+
+/**
+ * @brief Bind the buffer textures to the texture units from lightGridTextureUnit on and set the samplers uLights,
+ * uClusters and uClusterLights and the cluster mapping uClusterScale and uClusterSize of a program compiled with
+ * CLUSTERED. The program has to be in use.
+ *
+ * @param grid Light grid.
+ * @param shader Shader program.
+ */
+void lightGridBind(const LightGrid& grid, ShaderProgram& shader);
@@ -0,0 +1,285 @@
+#include "loader.h"
+
+#include "glstate.h"
+#include "profiler.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include <stb_image/stb_image.h>
+
+namespace detail
+{
+
+/* upload the next slice of a model, returns the number of bytes uploaded */
+std::size_t uploadModel(ModelAsset& asset, std::size_t budget)
+{
+    std::size_t used = 0;
+
+    while(asset._model < asset._source.models.size())
+    {
+        const ModelCacheEntry& entry = asset._source.models[asset._model];
+
+        /* allocate the buffers once, the data follows in slices */
+        if(asset.models.size() == asset._model)
+        {
+            Mesh mesh = asset._arena ? meshArenaAlloc(*asset._arena, nullptr, entry.vertexCount, nullptr, entry.indexCount)
+                                     : meshCreate(nullptr, entry.vertexCount, nullptr, entry.indexCount, asset._format);
+            if(mesh.format & VertexQuantizedPosition)
+            {
+                meshFitPositions(mesh, entry.vertices, entry.vertexCount);
+            }
+            asset.models.push_back(modelCacheEntryModel(entry, mesh));
+        }
+        const Mesh& mesh = asset.models.back().mesh;
+
+        /* the budget counts bytes in the GPU layout of the mesh */
+        std::size_t vertexSize = meshVertexSize(mesh.format) + ((mesh.format & VertexPositionStream) ? meshPositionSize(mesh.format) : 0);
+        std::size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+        if(asset._vertexDone < entry.vertexCount)
+        {
+            std::size_t count = std::min<std::size_t>(entry.vertexCount - asset._vertexDone, (budget - used) / vertexSize);
+            if(count == 0)
+            {
+                break;
+            }
+
+            meshUploadVertices(mesh, asset._vertexDone, entry.vertices + asset._vertexDone, count);
+            asset._vertexDone += count;
+            used += count * vertexSize;
+        }
+
+        if(asset._indexDone < entry.indexCount)
+        {
+            std::size_t count = std::min<std::size_t>(entry.indexCount - asset._indexDone, (budget - used) / indexSize);
+            if(count == 0)
+            {
+                break;
+            }
+
+            meshUploadIndices(mesh, asset._indexDone, entry.indices + asset._indexDone, count);
+            asset._indexDone += count;
+            used += count * indexSize;
+        }
+
+        if(asset._vertexDone == entry.vertexCount && asset._indexDone == entry.indexCount)
+        {
+            asset._model++;
+            asset._vertexDone = 0;
+            asset._indexDone = 0;
+        }
+    }
+
+    if(asset._model == asset._source.models.size())
+    {
+        modelSourceClose(asset._source);
+        asset.state = AssetReady;
+    }
+
+    return used;
+}
+
+/* upload the next rows of a texture, returns the number of bytes uploaded */
+std::size_t uploadTexture(TextureAsset& asset, std::size_t budget)
+{
+    Texture& texture = asset.texture;
+    std::size_t rowSize = 4 * static_cast<std::size_t>(texture.width);
+
+    if(texture.id == 0)
+    {
+        glGenTextures(1, &texture.id);
+        stateBindTexture(GL_TEXTURE_2D, texture.id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texture.width, texture.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    unsigned int rows = static_cast<unsigned int>(std::min<std::size_t>(texture.height - asset._rowsDone, budget / rowSize));
+    if(rows > 0)
+    {
+        stateBindTexture(GL_TEXTURE_2D, texture.id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, asset._rowsDone, texture.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, asset._pixels + asset._rowsDone * rowSize);
+        asset._rowsDone += rows;
+    }
+
+    stateBindTexture(GL_TEXTURE_2D, 0);
+    glCheckError();
+
+    if(asset._rowsDone == texture.height)
+    {
+        stbi_image_free(asset._pixels);
+        asset._pixels = nullptr;
+        asset.state = AssetReady;
+    }
+
+    return rows * rowSize;
+}
+
+/* move an asset from loading to uploading once its worker job is done */
+template<typename Asset>
+bool poll(Asset& asset)
+{
+    if(asset.state != AssetLoading)
+    {
+        return true;
+    }
+
+    if(asset._loaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return false;
+    }
+
+    try
+    {
+        asset._loaded.get();
+        asset.state = AssetUploading;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "[Loader] Couldn't load " << asset.path << ": " << e.what() << std::endl;
+        asset.error = e.what();
+        asset.state = AssetFailed;
+    }
+
+    return true;
+}
+
+template<typename Asset>
+void wait(Asset& asset)
+{
+    if(asset._loaded.valid())
+    {
+        threadPoolWait(threadPoolShared(), asset._loaded);
+        poll(asset);
+    }
+}
+
+}
+
+AssetLoader assetLoaderCreate(std::size_t uploadBudget)
+{
+    return AssetLoader{uploadBudget, {}, {}};
+}
+
+void assetLoaderDelete(AssetLoader &loader)
+{
+    for(auto& asset : loader.models)
+    {
+        detail::wait(*asset);
+
+        modelDelete(asset->models);
+        asset->models.clear();
+        modelSourceClose(asset->_source);
+    }
+
+    for(auto& asset : loader.textures)
+    {
+        detail::wait(*asset);
+
+        textureDelete(asset->texture);
+        asset->texture = Texture{};
+        stbi_image_free(asset->_pixels);
+        asset->_pixels = nullptr;
+    }
+
+    loader.models.clear();
+    loader.textures.clear();
+}
+
+std::shared_ptr<ModelAsset> assetLoadModel(AssetLoader &loader, const std::string &filepath, const ModelLoadOptions &options)
+{
+    auto asset = std::make_shared<ModelAsset>();
+    asset->path = filepath;
+    asset->_format = options.vertexFormat;
+    asset->_arena = options.arena;
+    asset->_loaded = threadPoolSubmit(threadPoolShared(), [asset, options]()
+    {
+        PROFILE_ZONE("loadModel");
+        modelSourceLoad(asset->path, options, asset->_source);
+    });
+
+    loader.models.push_back(asset);
+    return asset;
+}
+
+std::shared_ptr<TextureAsset> assetLoadTexture(AssetLoader &loader, const std::string &filepath)
+{
+    auto asset = std::make_shared<TextureAsset>();
+    asset->path = filepath;
+    asset->_loaded = threadPoolSubmit(threadPoolShared(), [asset]()
+    {
+        PROFILE_ZONE("loadTexture");
+
+        /* flip image to match opengl's texture coordinates */
+        stbi_set_flip_vertically_on_load_thread(true);
+
+        int width = 0, height = 0, components = 0;
+        asset->_pixels = stbi_load(asset->path.c_str(), &width, &height, &components, 4);
+        if(asset->_pixels == nullptr)
+        {
+            throw std::runtime_error("[Texture] couldn't load image file " + asset->path);
+        }
+
+        asset->texture.width = width;
+        asset->texture.height = height;
+    });
+
+    loader.textures.push_back(asset);
+    return asset;
+}
+
+bool assetLoaderUpdate(AssetLoader &loader)
+{
+    PROFILE_ZONE("assetLoaderUpdate");
+
+    std::size_t budget = loader.uploadBudget;
+
+    /* assets are uploaded in request order, so the first one finishes as early as possible */
+    for(auto& asset : loader.models)
+    {
+        if(detail::poll(*asset) && asset->state == AssetUploading && budget > 0)
+        {
+            budget -= std::min(budget, detail::uploadModel(*asset, budget));
+        }
+    }
+
+    for(auto& asset : loader.textures)
+    {
+        if(detail::poll(*asset) && asset->state == AssetUploading && budget > 0)
+        {
+            budget -= std::min(budget, detail::uploadTexture(*asset, budget));
+        }
+    }
+
+    /* finished assets belong to the caller now */
+    auto finished = [](const auto& asset) { return asset->state == AssetReady || asset->state == AssetFailed; };
+    loader.models.erase(std::remove_if(loader.models.begin(), loader.models.end(), finished), loader.models.end());
+    loader.textures.erase(std::remove_if(loader.textures.begin(), loader.textures.end(), finished), loader.textures.end());
+
+    return loader.models.empty() && loader.textures.empty();
+}
+
+void assetLoaderFinish(AssetLoader &loader)
+{
+    std::size_t budget = loader.uploadBudget;
+    loader.uploadBudget = std::numeric_limits<std::size_t>::max();
+
+    for(auto& asset : loader.models)
+    {
+        detail::wait(*asset);
+    }
+    for(auto& asset : loader.textures)
+    {
+        detail::wait(*asset);
+    }
+    assetLoaderUpdate(loader);
+
+    loader.uploadBudget = budget;
+}
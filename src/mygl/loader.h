@@ -0,0 +1,110 @@
+#pragma once
+
+#include "model.h"
+#include "modelcache.h"
+#include "texture.h"
+
+#include <future>
+#include <memory>
+#include <vector>
+
+enum eAssetState { AssetLoading = 0, AssetUploading = 1, AssetReady = 2, AssetFailed = 3 };
+
+struct ModelAsset
+{
+    std::string path;
+    eAssetState state = AssetLoading;
+    std::string error;
+
+    /* valid once the state is AssetReady, the caller takes ownership (modelDelete) */
+    std::vector<Model> models;
+
+    /* loader internals */
+    std::future<void> _loaded;
+    ModelSource _source;
+    unsigned int _format = VertexFloat;
+    MeshArena* _arena = nullptr;
+    std::size_t _model = 0;
+    std::size_t _vertexDone = 0;
+    std::size_t _indexDone = 0;
+};
+
+struct TextureAsset
+{
+    std::string path;
+    eAssetState state = AssetLoading;
+    std::string error;
+
+    /* valid once the state is AssetReady, the caller takes ownership (textureDelete) */
+    Texture texture;
+
+    /* loader internals */
+    std::future<void> _loaded;
+    unsigned char* _pixels = nullptr;
+    unsigned int _rowsDone = 0;
+};
+
+struct AssetLoader
+{
+    /* maximum number of bytes uploaded to OpenGL per assetLoaderUpdate */
+    std::size_t uploadBudget;
+
+    std::vector<std::shared_ptr<ModelAsset>> models;
+    std::vector<std::shared_ptr<TextureAsset>> textures;
+};
+
+/**
+ * @brief Create a loader that reads and decodes assets on the shared thread pool and uploads them to OpenGL in
+ * bounded slices.
+ *
+ * @param uploadBudget Maximum number of bytes uploaded per call of assetLoaderUpdate.
+ *
+ * @return Asset loader.
+ */
+AssetLoader assetLoaderCreate(std::size_t uploadBudget = 4 << 20);
+
+/**
+ * @brief Wait for all pending worker jobs and delete everything that was not handed out yet. Has to be called on the
+ * OpenGL thread.
+ *
+ * @param loader Asset loader to delete.
+ */
+void assetLoaderDelete(AssetLoader& loader);
+
+/**
+ * @brief Start loading an OBJ file in the background (see modelLoad).
+ *
+ * @param loader Asset loader.
+ * @param filepath Path to the OBJ file.
+ * @param options Loader options.
+ *
+ * @return Handle that becomes AssetReady (or AssetFailed) during one of the next assetLoaderUpdate calls.
+ */
+std::shared_ptr<ModelAsset> assetLoadModel(AssetLoader& loader, const std::string& filepath, const ModelLoadOptions& options = {});
+
+/**
+ * @brief Start loading a texture in the background (see textureLoad).
+ *
+ * @param loader Asset loader.
+ * @param filepath Path to the image file.
+ *
+ * @return Handle that becomes AssetReady (or AssetFailed) during one of the next assetLoaderUpdate calls.
+ */
+std::shared_ptr<TextureAsset> assetLoadTexture(AssetLoader& loader, const std::string& filepath);
+
+/**
+ * @brief Upload finished assets to OpenGL, at most uploadBudget bytes per call. Has to be called once per frame on the
+ * OpenGL thread.
+ *
+ * @param loader Asset loader.
+ *
+ * @return True if all requested assets are finished.
+ */
+bool assetLoaderUpdate(AssetLoader& loader);
+
+/**
+ * @brief Block until all requested assets are finished, ignoring the upload budget.
+ *
+ * @param loader Asset loader.
+ */
+void assetLoaderFinish(AssetLoader& loader);
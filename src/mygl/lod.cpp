@@ -0,0 +1,458 @@
+#include "lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace detail
+{
+
+/* symmetric 4x4 matrix of the plane distance quadric, only the upper triangle is stored */
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+};
+
+Quadric quadricPlane(const Vector3D& n, const Vector3D& p)
+{
+    double a = n.x, b = n.y, c = n.z;
+    double d = -(a * p.x + b * p.y + c * p.z);
+
+    return {a * a, a * b, a * c, a * d,
+            b * b, b * c, b * d,
+            c * c, c * d,
+            d * d};
+}
+
+void quadricAdd(Quadric& q, const Quadric& r)
+{
+    q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a03 += r.a03;
+    q.a11 += r.a11; q.a12 += r.a12; q.a13 += r.a13;
+    q.a22 += r.a22; q.a23 += r.a23;
+    q.a33 += r.a33;
+}
+
+double quadricError(const Quadric& q, const Vector3D& p)
+{
+    double x = p.x, y = p.y, z = p.z;
+
+    return q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x
+         + q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y
+         + q.a22 * z * z + 2 * q.a23 * z
+         + q.a33;
+}
+
+struct PositionHash
+{
+    std::size_t operator()(const Vector3D& p) const
+    {
+        /* -0 and +0 are equal positions, adding +0 turns -0 into +0 so both get the same bits */
+        const float values[3] = {p.x + 0.0f, p.y + 0.0f, p.z + 0.0f};
+        std::uint32_t bits[3];
+        std::memcpy(bits, values, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+struct PositionEqual
+{
+    bool operator()(const Vector3D& a, const Vector3D& b) const
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+};
+
+/*
+ * Edge collapses work on position groups (all vertices at the same position), so attribute seams and flat shading
+ * don't stop the simplification. A collapse only moves one group onto another existing one (half-edge collapse), the
+ * vertices of the result are always vertices of the original model.
+ */
+struct Simplifier
+{
+    struct Triangle
+    {
+        unsigned int corner[3];
+        unsigned int material;
+    };
+
+    const ModelData* model = nullptr;
+
+    std::vector<unsigned int> group;
+    std::vector<Vector3D> position;
+    std::vector<std::vector<unsigned int>> groupVertices;
+
+    std::vector<unsigned int> parent;
+    std::vector<bool> locked;
+    std::vector<Quadric> quadric;
+
+    std::vector<Triangle> triangles;
+    double maxError = 0.0;
+};
+
+unsigned int find(Simplifier& s, unsigned int g)
+{
+    while(s.parent[g] != g)
+    {
+        s.parent[g] = s.parent[s.parent[g]];
+        g = s.parent[g];
+    }
+    return g;
+}
+
+Vector3D faceNormal(const Vector3D& a, const Vector3D& b, const Vector3D& c)
+{
+    return cross(b - a, c - a);
+}
+
+void simplifierInit(Simplifier& s, const ModelData& model)
+{
+    s.model = &model;
+
+    /* position groups */
+    std::unordered_map<Vector3D, unsigned int, PositionHash, PositionEqual> groups;
+    s.group.resize(model.vertices.size());
+    for(std::size_t v = 0; v < model.vertices.size(); v++)
+    {
+        auto [it, inserted] = groups.try_emplace(model.vertices[v].pos, static_cast<unsigned int>(s.position.size()));
+        if(inserted)
+        {
+            s.position.push_back(model.vertices[v].pos);
+            s.groupVertices.emplace_back();
+        }
+        s.group[v] = it->second;
+        s.groupVertices[it->second].push_back(static_cast<unsigned int>(v));
+    }
+
+    std::size_t groupCount = s.position.size();
+    s.parent.resize(groupCount);
+    for(std::size_t g = 0; g < groupCount; g++)
+    {
+        s.parent[g] = static_cast<unsigned int>(g);
+    }
+    s.locked.assign(groupCount, false);
+    s.quadric.assign(groupCount, Quadric{});
+
+    /* triangles of all material ranges (faces without material are never drawn) */
+    std::vector<unsigned int> groupMaterial(groupCount, ~0u);
+    for(std::size_t m = 0; m < model.material.size(); m++)
+    {
+        const Material& material = model.material[m];
+        for(unsigned int i = material.indexOffset; i + 2 < material.indexOffset + material.indexCount; i += 3)
+        {
+            Simplifier::Triangle t{{model.indices[i], model.indices[i + 1], model.indices[i + 2]}, static_cast<unsigned int>(m)};
+            unsigned int g[3] = {s.group[t.corner[0]], s.group[t.corner[1]], s.group[t.corner[2]]};
+            if(g[0] == g[1] || g[1] == g[2] || g[0] == g[2])
+            {
+                continue;
+            }
+
+            s.triangles.push_back(t);
+
+            Vector3D n = faceNormal(s.position[g[0]], s.position[g[1]], s.position[g[2]]);
+            if(length(n) > 0.0f)
+            {
+                Quadric q = quadricPlane(normalize(n), s.position[g[0]]);
+                for(unsigned int c : g)
+                {
+                    quadricAdd(s.quadric[c], q);
+                }
+            }
+
+            /* groups shared by several materials are material boundaries */
+            for(unsigned int c : g)
+            {
+                if(groupMaterial[c] != ~0u && groupMaterial[c] != m)
+                {
+                    s.locked[c] = true;
+                }
+                groupMaterial[c] = static_cast<unsigned int>(m);
+            }
+        }
+    }
+
+    /* groups on open borders (or non-manifold edges) stay where they are, otherwise holes open up */
+    std::unordered_map<std::uint64_t, unsigned int> edgeCount;
+    for(const auto& t : s.triangles)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            std::uint64_t a = s.group[t.corner[c]], b = s.group[t.corner[(c + 1) % 3]];
+            edgeCount[std::min(a, b) << 32 | std::max(a, b)]++;
+        }
+    }
+    for(const auto& [edge, count] : edgeCount)
+    {
+        if(count != 2)
+        {
+            s.locked[edge >> 32] = true;
+            s.locked[edge & 0xffffffffu] = true;
+        }
+    }
+}
+
+/* one round of independent collapses in order of increasing error, returns false if nothing could be collapsed */
+bool simplifyPass(Simplifier& s, std::size_t targetTriangles)
+{
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        double error;
+    };
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    std::size_t groupCount = s.position.size();
+
+    /* current groups of all triangle corners */
+    std::vector<unsigned int> corners(s.triangles.size() * 3);
+    for(std::size_t t = 0; t < s.triangles.size(); t++)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            corners[3 * t + c] = find(s, s.group[s.triangles[t].corner[c]]);
+        }
+    }
+
+    /* unique edges with the cheaper allowed collapse direction */
+    std::vector<std::uint64_t> edges;
+    edges.reserve(corners.size());
+    for(std::size_t t = 0; t < s.triangles.size(); t++)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            std::uint64_t a = corners[3 * t + c], b = corners[3 * t + (c + 1) % 3];
+            edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    std::vector<Collapse> collapses;
+    for(std::uint64_t edge : edges)
+    {
+        unsigned int a = static_cast<unsigned int>(edge >> 32), b = static_cast<unsigned int>(edge & 0xffffffffu);
+
+        Quadric q = s.quadric[a];
+        quadricAdd(q, s.quadric[b]);
+
+        double ab = s.locked[a] ? infinity : quadricError(q, s.position[b]);
+        double ba = s.locked[b] ? infinity : quadricError(q, s.position[a]);
+        if(ab == infinity && ba == infinity)
+        {
+            continue;
+        }
+
+        collapses.push_back(ab <= ba ? Collapse{a, b, ab} : Collapse{b, a, ba});
+    }
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+    /* triangles around each group */
+    std::vector<unsigned int> offset(groupCount + 1, 0);
+    for(unsigned int g : corners)
+    {
+        offset[g + 1]++;
+    }
+    for(std::size_t g = 0; g < groupCount; g++)
+    {
+        offset[g + 1] += offset[g];
+    }
+    std::vector<unsigned int> around(corners.size());
+    std::vector<unsigned int> fill(offset.begin(), offset.end() - 1);
+    for(std::size_t i = 0; i < corners.size(); i++)
+    {
+        around[fill[corners[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<bool> touched(groupCount, false);
+    std::size_t remaining = s.triangles.size();
+    bool collapsed = false;
+
+    for(const auto& collapse : collapses)
+    {
+        if(remaining <= targetTriangles)
+        {
+            break;
+        }
+        if(touched[collapse.from] || touched[collapse.to])
+        {
+            continue;
+        }
+
+        /* reject collapses that flip a triangle */
+        bool valid = true;
+        std::size_t removed = 0;
+        for(unsigned int a = offset[collapse.from]; a < offset[collapse.from + 1] && valid; a++)
+        {
+            const unsigned int* g = &corners[3 * around[a]];
+            if(g[0] == collapse.to || g[1] == collapse.to || g[2] == collapse.to)
+            {
+                removed++;
+                continue;
+            }
+
+            Vector3D p[3], q[3];
+            for(int c = 0; c < 3; c++)
+            {
+                p[c] = s.position[g[c]];
+                q[c] = g[c] == collapse.from ? s.position[collapse.to] : p[c];
+            }
+
+            Vector3D before = faceNormal(p[0], p[1], p[2]);
+            Vector3D after = faceNormal(q[0], q[1], q[2]);
+            valid = dot(before, after) > 0.0f;
+        }
+
+        if(!valid)
+        {
+            continue;
+        }
+
+        s.parent[collapse.from] = collapse.to;
+        quadricAdd(s.quadric[collapse.to], s.quadric[collapse.from]);
+        s.maxError = std::max(s.maxError, collapse.error);
+        remaining -= removed;
+        collapsed = true;
+
+        /* the neighborhood changed, its flip checks of this pass would be outdated */
+        for(unsigned int a = offset[collapse.from]; a < offset[collapse.from + 1]; a++)
+        {
+            for(int c = 0; c < 3; c++)
+            {
+                touched[corners[3 * around[a] + c]] = true;
+            }
+        }
+        touched[collapse.to] = true;
+    }
+
+    /* drop triangles that collapsed */
+    auto degenerate = [&s](const Simplifier::Triangle& t)
+    {
+        unsigned int g0 = find(s, s.group[t.corner[0]]), g1 = find(s, s.group[t.corner[1]]), g2 = find(s, s.group[t.corner[2]]);
+        return g0 == g1 || g1 == g2 || g0 == g2;
+    };
+    s.triangles.erase(std::remove_if(s.triangles.begin(), s.triangles.end(), degenerate), s.triangles.end());
+
+    return collapsed;
+}
+
+/* vertex of group g that matches the attributes of vertex v best */
+unsigned int closestVertex(Simplifier& s, unsigned int v, unsigned int g)
+{
+    const Vertex& source = s.model->vertices[v];
+
+    unsigned int best = s.groupVertices[g].front();
+    float bestScore = -std::numeric_limits<float>::infinity();
+    for(unsigned int candidate : s.groupVertices[g])
+    {
+        const Vertex& target = s.model->vertices[candidate];
+        float score = dot(source.normal, target.normal) - length(source.uv - target.uv);
+        if(score > bestScore)
+        {
+            bestScore = score;
+            best = candidate;
+        }
+    }
+
+    return best;
+}
+
+}
+
+void modelComputeBounds(ModelData &model)
+{
+    const Vector3D* positions = model.vertices.empty() ? nullptr : &model.vertices.front().pos;
+    model.bounds = boundsCompute(positions, sizeof(Vertex), nullptr, model.vertices.size());
+
+    for(auto& material : model.material)
+    {
+        material.bounds = boundsCompute(positions, sizeof(Vertex), model.indices.data() + material.indexOffset, material.indexCount);
+    }
+}
+
+void modelGenerateLods(ModelData &model, unsigned int levels)
+{
+    model.lod.clear();
+
+    detail::Simplifier s;
+    detail::simplifierInit(s, model);
+
+    for(unsigned int level = 0; level < levels; level++)
+    {
+        std::size_t before = s.triangles.size();
+        std::size_t target = before / 2;
+
+        while(s.triangles.size() > target && detail::simplifyPass(s, target))
+        {
+            /* every pass collapses a set of independent edges */
+        }
+
+        /* stop once the mesh doesn't get noticeably simpler anymore */
+        if(s.triangles.size() == 0 || s.triangles.size() * 10 > before * 9)
+        {
+            break;
+        }
+
+        ModelLod& lod = model.lod.emplace_back();
+        lod.error = static_cast<float>(std::sqrt(s.maxError));
+
+        for(std::size_t m = 0; m < model.material.size(); m++)
+        {
+            Material material = model.material[m];
+            material.indexOffset = static_cast<unsigned int>(model.indices.size());
+
+            for(const auto& t : s.triangles)
+            {
+                if(t.material != m)
+                {
+                    continue;
+                }
+
+                for(unsigned int v : t.corner)
+                {
+                    unsigned int g = detail::find(s, s.group[v]);
+                    model.indices.push_back(g == s.group[v] ? v : detail::closestVertex(s, v, g));
+                }
+            }
+
+            material.indexCount = static_cast<unsigned int>(model.indices.size()) - material.indexOffset;
+            lod.material.push_back(material);
+        }
+    }
+}
+
+unsigned int modelSelectLod(const Model &model, const Camera &cam, const Matrix4D &transformation, float maxPixelError)
+{
+    if(model.lod.empty())
+    {
+        return 0;
+    }
+
+    Vector3D center = transformation * Vector4D(model.bounds.center, 1.0f);
+    float distance = length(center - cam.position) - model.bounds.radius;
+    if(distance <= cam.nearPlane)
+    {
+        return 0;
+    }
+
+    /* size of one object space unit on screen at this distance */
+    float pixelsPerUnit = cam.height / (2.0f * std::tan(0.5f * cam.fov) * distance);
+
+    unsigned int level = 0;
+    while(level < model.lod.size() && model.lod[level].error * pixelsPerUnit <= maxPixelError)
+    {
+        level++;
+    }
+
+    return level;
+}
+
+const std::vector<Material>& modelLodMaterial(const Model &model, unsigned int level)
+{
+    return level == 0 ? model.material : model.lod[level - 1].material;
+}
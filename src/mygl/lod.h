@@ -0,0 +1,44 @@
+#pragma once
+
+#include "camera.h"
+#include "model.h"
+
+/**
+ * @brief Bounding box and sphere of all vertices of a model and of the triangles of each material range. Has to run
+ * before the levels are generated, which copy the bounds of the materials.
+ *
+ * @param model Model data, bounds of the model and its materials are updated in place.
+ */
+void modelComputeBounds(ModelData& model);
+
+/**
+ * @brief Generate a chain of simplified levels with quadric error edge collapses (Garland/Heckbert). Every level
+ * halves the triangle count of the previous one. Vertices on material boundaries and open borders are never moved, so
+ * material ranges stay closed. The levels reuse the existing vertices and append their indices to the index buffer.
+ *
+ * @param model Model data, lod is filled in place.
+ * @param levels Maximum number of levels to generate (stops earlier if the mesh can't be simplified further).
+ */
+void modelGenerateLods(ModelData& model, unsigned int levels);
+
+/**
+ * @brief Pick the coarsest level whose geometric error projects to less than maxPixelError pixels on screen.
+ *
+ * @param model Model with levels and bounding sphere.
+ * @param cam Camera the model is viewed with.
+ * @param transformation Model matrix (rigid, without scaling).
+ * @param maxPixelError Largest tolerated error on screen.
+ *
+ * @return 0 for the full model, i for model.lod[i - 1].
+ */
+unsigned int modelSelectLod(const Model& model, const Camera& cam, const Matrix4D& transformation, float maxPixelError = 1.0f);
+
+/**
+ * @brief Materials (with index ranges) of a level.
+ *
+ * @param model Model.
+ * @param level Level as returned by modelSelectLod.
+ *
+ * @return Materials of the level.
+ */
+const std::vector<Material>& modelLodMaterial(const Model& model, unsigned int level);
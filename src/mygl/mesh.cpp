@@ -1,42 +1,386 @@
 #include "mesh.h"
 
-Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+#include "arena.h"
+#include "glstate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace detail
+{
+
+/* float to IEEE half, rounded to nearest even */
+std::uint16_t toHalf(float value)
+{
+    std::uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+
+    std::uint32_t sign = (f >> 16) & 0x8000u;
+    std::uint32_t exponent = (f >> 23) & 0xffu;
+    std::uint32_t mantissa = f & 0x7fffffu;
+
+    /* inf and nan */
+    if(exponent == 0xffu)
+    {
+        return static_cast<std::uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    }
+
+    int e = static_cast<int>(exponent) - 127 + 15;
+    if(e >= 31)
+    {
+        return static_cast<std::uint16_t>(sign | 0x7c00u);
+    }
+
+    std::uint32_t shift;
+    if(e <= 0)
+    {
+        /* subnormal half (or zero), the implicit one becomes part of the mantissa */
+        if(e < -10)
+        {
+            return static_cast<std::uint16_t>(sign);
+        }
+        mantissa |= 0x800000u;
+        shift = static_cast<std::uint32_t>(14 - e);
+        e = 0;
+    }
+    else
+    {
+        shift = 13;
+    }
+
+    std::uint32_t half = (static_cast<std::uint32_t>(e) << 10) | (mantissa >> shift);
+    std::uint32_t rest = mantissa & ((1u << shift) - 1u);
+    std::uint32_t halfway = 1u << (shift - 1u);
+
+    /* a carry out of the mantissa correctly increments the exponent */
+    if(rest > halfway || (rest == halfway && (half & 1u)))
+    {
+        half++;
+    }
+
+    return static_cast<std::uint16_t>(sign | half);
+}
+
+std::int16_t toSnorm16(float value)
+{
+    return static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+std::uint16_t toUnorm16(float value)
+{
+    return static_cast<std::uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+/* map the unit sphere onto the [-1, 1] square (octahedron unfolded around the z axis) */
+void octahedralEncode(const Vector3D& n, std::int16_t out[2])
+{
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if(l1 == 0.0f)
+    {
+        out[0] = out[1] = 0;
+        return;
+    }
+
+    float x = n.x / l1;
+    float y = n.y / l1;
+    if(n.z < 0.0f)
+    {
+        float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
+
+std::size_t positionSize(unsigned int format)
+{
+    /* 16 bit positions are padded to 8 bytes to keep the following attributes 4 byte aligned */
+    return (format & (VertexHalfPosition | VertexQuantizedPosition)) ? 4 * sizeof(std::uint16_t) : 3 * sizeof(float);
+}
+
+void positionAttribute(unsigned int format, std::size_t stride)
+{
+    glEnableVertexAttribArray(eDataIdx::Position);
+    if(format & VertexQuantizedPosition)
+        glVertexAttribPointer(eDataIdx::Position, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*) 0);
+    else if(format & VertexHalfPosition)
+        glVertexAttribPointer(eDataIdx::Position, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*) 0);
+    else
+        glVertexAttribPointer(eDataIdx::Position, 3, GL_FLOAT, GL_FALSE, stride, (void*) 0);
+}
+
+std::size_t normalSize(unsigned int format)
+{
+    if(format & VertexNoNormal)
+    {
+        return 0;
+    }
+    return (format & VertexOctahedralNormal) ? 2 * sizeof(std::int16_t) : 3 * sizeof(float);
+}
+
+std::size_t uvSize(unsigned int format)
+{
+    return (format & VertexHalfUV) ? 2 * sizeof(std::uint16_t) : 2 * sizeof(float);
+}
+
+/* write one vertex in the packed layout of the mesh */
+void packVertex(const Mesh& mesh, const Vertex& vertex, unsigned char* out)
+{
+    unsigned int format = mesh.format;
+
+    if(format & VertexQuantizedPosition)
+    {
+        std::uint16_t p[4] = {0, 0, 0, 0};
+        for(unsigned int i = 0; i < 3; i++)
+        {
+            p[i] = toUnorm16(mesh.positionScale[i] > 0.0f ? (vertex.pos[i] - mesh.positionOffset[i]) / mesh.positionScale[i] : 0.0f);
+        }
+        std::memcpy(out, p, sizeof(p));
+    }
+    else if(format & VertexHalfPosition)
+    {
+        std::uint16_t p[4] = {toHalf(vertex.pos.x), toHalf(vertex.pos.y), toHalf(vertex.pos.z), 0};
+        std::memcpy(out, p, sizeof(p));
+    }
+    else
+    {
+        std::memcpy(out, &vertex.pos, 3 * sizeof(float));
+    }
+    out += positionSize(format);
+
+    if(format & VertexNoNormal)
+    {
+        /* nothing to write, the attribute is disabled */
+    }
+    else if(format & VertexOctahedralNormal)
+    {
+        std::int16_t n[2];
+        octahedralEncode(vertex.normal, n);
+        std::memcpy(out, n, sizeof(n));
+    }
+    else
+    {
+        std::memcpy(out, &vertex.normal, 3 * sizeof(float));
+    }
+    out += normalSize(format);
+
+    if(format & VertexHalfUV)
+    {
+        std::uint16_t uv[2] = {toHalf(vertex.uv.x), toHalf(vertex.uv.y)};
+        std::memcpy(out, uv, sizeof(uv));
+    }
+    else
+    {
+        std::memcpy(out, &vertex.uv, 2 * sizeof(float));
+    }
+}
+
+}
+
+std::size_t meshVertexSize(unsigned int format)
+{
+    return detail::positionSize(format) + detail::normalSize(format) + detail::uvSize(format);
+}
+
+void meshVertexAttributes(unsigned int format)
 {
-    GLuint vao = 0, vbo = 0, ebo = 0;
+    std::size_t stride = meshVertexSize(format);
+    std::size_t normalOffset = detail::positionSize(format);
+    std::size_t uvOffset = normalOffset + detail::normalSize(format);
 
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+    detail::positionAttribute(format, stride);
 
-    glBindVertexArray(vao);
+    if(!(format & VertexNoNormal))
     {
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(eDataIdx::Normal);
+        if(format & VertexOctahedralNormal)
+            glVertexAttribPointer(eDataIdx::Normal, 2, GL_SHORT, GL_TRUE, stride, (void*) normalOffset);
+        else
+            glVertexAttribPointer(eDataIdx::Normal, 3, GL_FLOAT, GL_FALSE, stride, (void*) normalOffset);
+    }
+
+    glEnableVertexAttribArray(eDataIdx::UV);
+
+    if(format & VertexHalfUV)
+        glVertexAttribPointer(eDataIdx::UV, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*) uvOffset);
+    else
+        glVertexAttribPointer(eDataIdx::UV, 2, GL_FLOAT, GL_FALSE, stride, (void*) uvOffset);
+}
+
+std::size_t meshPositionSize(unsigned int format)
+{
+    return detail::positionSize(format);
+}
+
+void meshPositionAttributes(unsigned int format)
+{
+    detail::positionAttribute(format, meshPositionSize(format));
+}
+
+Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, unsigned int format)
+{
+    return meshCreate(vertices.data(), vertices.size(), indices.data(), indices.size(), format);
+}
+
+Mesh meshCreate(const Vertex *vertices, std::size_t vertexCount, const unsigned int *indices, std::size_t indexCount, unsigned int format)
+{
+    Mesh mesh;
+    mesh.size_vbo = (unsigned int) vertexCount;
+    mesh.size_ibo = (unsigned int) indexCount;
+    mesh.format = format;
+    mesh.indexType = vertexCount < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    if((format & VertexQuantizedPosition) && vertices != nullptr)
+    {
+        meshFitPositions(mesh, vertices, vertexCount);
+    }
+
+    std::size_t stride = meshVertexSize(format);
+    std::size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
+
+    stateBindVertexArray(mesh.vao);
+    {
+        stateBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * stride, nullptr, GL_STATIC_DRAW);
         glCheckError();
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, nullptr, GL_STATIC_DRAW);
         glCheckError();
 
-        glEnableVertexAttribArray(eDataIdx::Position);
-        glEnableVertexAttribArray(eDataIdx::Normal);
-        glEnableVertexAttribArray(eDataIdx::UV);
-        glVertexAttribPointer(eDataIdx::Position,   3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, pos));
-        glVertexAttribPointer(eDataIdx::Normal,     3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, normal));
-        glVertexAttribPointer(eDataIdx::UV,         2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, uv));
+        meshVertexAttributes(format);
         glCheckError();
     }
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if(format & VertexPositionStream)
+    {
+        glGenVertexArrays(1, &mesh.depthVao);
+        glGenBuffers(1, &mesh.positionVbo);
+
+        stateBindVertexArray(mesh.depthVao);
+        stateBindBuffer(GL_ARRAY_BUFFER, mesh.positionVbo);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * meshPositionSize(format), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        meshPositionAttributes(format);
+        glCheckError();
+    }
+
+    stateBindVertexArray(0);
+    stateBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-    return Mesh{vao, vbo, ebo, (unsigned int) vertices.size(), (unsigned int) indices.size()};
+    if(vertices != nullptr)
+    {
+        meshUploadVertices(mesh, 0, vertices, vertexCount);
+    }
+    if(indices != nullptr)
+    {
+        meshUploadIndices(mesh, 0, indices, indexCount);
+    }
+
+    return mesh;
+}
+
+void meshFitPositions(Mesh &mesh, const Vertex *vertices, std::size_t count)
+{
+    if(count == 0)
+    {
+        return;
+    }
+
+    Vector3D lo = vertices[0].pos, hi = vertices[0].pos;
+    for(std::size_t v = 1; v < count; v++)
+    {
+        for(unsigned int i = 0; i < 3; i++)
+        {
+            lo[i] = std::min(lo[i], vertices[v].pos[i]);
+            hi[i] = std::max(hi[i], vertices[v].pos[i]);
+        }
+    }
+
+    mesh.positionOffset = lo;
+    mesh.positionScale = hi - lo;
+}
+
+void meshUploadVertices(const Mesh &mesh, std::size_t first, const Vertex *vertices, std::size_t count)
+{
+    std::size_t stride = meshVertexSize(mesh.format);
+
+    std::vector<unsigned char> packed;
+
+    stateBindBuffer(GL_COPY_WRITE_BUFFER, mesh.vbo);
+    if((mesh.format & ~VertexPositionStream) == VertexFloat)
+    {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (mesh.baseVertex + first) * stride, count * stride, vertices);
+    }
+    else
+    {
+        packed.resize(count * stride);
+        for(std::size_t v = 0; v < count; v++)
+        {
+            detail::packVertex(mesh, vertices[v], packed.data() + v * stride);
+        }
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (mesh.baseVertex + first) * stride, packed.size(), packed.data());
+    }
+
+    /* the position-only stream gets the positions of the packed vertices, they come first in every vertex */
+    if(mesh.format & VertexPositionStream)
+    {
+        std::size_t positionSize = meshPositionSize(mesh.format);
+        std::vector<unsigned char> positions(count * positionSize);
+        for(std::size_t v = 0; v < count; v++)
+        {
+            const void* source = packed.empty() ? static_cast<const void*>(&vertices[v].pos) : packed.data() + v * stride;
+            std::memcpy(positions.data() + v * positionSize, source, positionSize);
+        }
+
+        stateBindBuffer(GL_COPY_WRITE_BUFFER, mesh.positionVbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (mesh.baseVertex + first) * positionSize, positions.size(), positions.data());
+    }
+    stateBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glCheckError();
+}
+
+void meshUploadIndices(const Mesh &mesh, std::size_t first, const unsigned int *indices, std::size_t count)
+{
+    stateBindBuffer(GL_COPY_WRITE_BUFFER, mesh.ebo);
+    if(mesh.indexType == GL_UNSIGNED_INT)
+    {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (mesh.baseIndex + first) * sizeof(GLuint), count * sizeof(GLuint), indices);
+    }
+    else
+    {
+        std::vector<GLushort> narrow(indices, indices + count);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (mesh.baseIndex + first) * sizeof(GLushort), narrow.size() * sizeof(GLushort), narrow.data());
+    }
+    stateBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glCheckError();
 }
 
 void meshDelete(const Mesh &mesh)
 {
+    if(mesh.page != nullptr)
+    {
+        meshArenaFree(mesh);
+        return;
+    }
+
     glDeleteBuffers(1, &mesh.vbo);
     glDeleteBuffers(1, &mesh.ebo);
     glDeleteVertexArrays(1, &mesh.vao);
+    if(mesh.depthVao != 0)
+    {
+        glDeleteBuffers(1, &mesh.positionVbo);
+        glDeleteVertexArrays(1, &mesh.depthVao);
+    }
+    stateInvalidate();
 }
@@ -13,22 +13,58 @@ struct Vertex
     Vector2D uv;
 };
 
+/* layout of the vertex buffer, the flags can be combined (except the two position formats) */
+enum eVertexFormat : unsigned int
+{
+    VertexFloat = 0,                    /* 32 bit floats for everything, 32 bytes per vertex */
+    VertexHalfPosition = 1 << 0,        /* positions as 16 bit floats */
+    VertexQuantizedPosition = 1 << 1,   /* positions as 16 bit normalized integers inside the bounding box */
+    VertexOctahedralNormal = 1 << 2,    /* normals as 2 x 16 bit normalized integers (octahedral mapping) */
+    VertexHalfUV = 1 << 3,              /* uv coordinates as 16 bit floats */
+    VertexPositionStream = 1 << 4,      /* positions are also stored tightly packed in a buffer of their own, drawn
+                                           with depthVao in depth-only passes */
+    VertexNoNormal = 1 << 5,            /* no normals, for shaders that don't read aNormal (attribute left disabled) */
+
+    VertexCompact = VertexQuantizedPosition | VertexOctahedralNormal | VertexHalfUV     /* 16 bytes per vertex */
+};
+
+struct MeshArenaPage;
+
 struct Mesh
 {
     GLuint vao = 0;
     GLuint vbo = 0;
     GLuint ebo = 0;
 
+    /* position-only stream and its VAO (shares the index buffer), only with VertexPositionStream */
+    GLuint positionVbo = 0;
+    GLuint depthVao = 0;
+
     unsigned int size_vbo = 0;
     unsigned int size_ibo = 0;
+
+    unsigned int format = VertexFloat;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    /* quantized positions decode to positionOffset + positionScale * position */
+    Vector3D positionOffset = {0.0f, 0.0f, 0.0f};
+    Vector3D positionScale = {1.0f, 1.0f, 1.0f};
+
+    /* meshes sub-allocated from a MeshArena share the buffers of a page and start at baseVertex/baseIndex (see arena.h) */
+    MeshArenaPage* page = nullptr;
+    unsigned int baseVertex = 0;
+    unsigned int baseIndex = 0;
 };
 
 /**
  * @brief Initializes all buffer objects (VBO, IBO) required for the mesh and fill it with data. Further, a vertex array
- * object (VAO) is created and the buffer objects are bind to it.
+ * object (VAO) is created and the buffer objects are bind to it. Meshes with less than 65536 vertices get 16 bit
+ * indices, so draw calls have to use mesh.indexType. With VertexPositionStream the positions are also written to a
+ * position-only buffer with a VAO of its own (depthVao).
  *
  * @param vertices Data for each vertex of the mesh (position, color, normal and uv coordinate data).
  * @param indices List of indices that form polygons in the mesh.
+ * @param format Combination of eVertexFormat flags the vertices are stored with on the GPU.
  *
  * @return Initialized mesh structure that can be drawn with OpenGL.
  *
@@ -36,13 +72,105 @@ struct Mesh
  *
  *   Mesh myMesh = meshCreate(vertex-data, index-data);
  *   glBindVertexArray(myMesh.vao);
- *   glDrawElements(GL_TRIANGLES, myMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+ *   glDrawElements(GL_TRIANGLES, myMesh.size_ibo, myMesh.indexType, nullptr);
+ *
+ */
+Mesh meshCreate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int format = VertexFloat);
+
+/**
+ * @brief Same as above, but takes the data from plain memory (e.g. a mapped file) instead of vectors. If vertices or
+ * indices are nullptr, the buffers are only allocated and can be filled with meshUploadVertices / meshUploadIndices
+ * (for quantized positions call meshFitPositions first).
  *
+ * @param vertices Pointer to vertexCount vertices.
+ * @param vertexCount Number of vertices.
+ * @param indices Pointer to indexCount indices.
+ * @param indexCount Number of indices.
+ * @param format Combination of eVertexFormat flags the vertices are stored with on the GPU.
+ *
+ * @return Initialized mesh structure that can be drawn with OpenGL.
  */
-Mesh meshCreate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+Mesh meshCreate(const Vertex* vertices, std::size_t vertexCount, const unsigned int* indices, std::size_t indexCount, unsigned int format = VertexFloat);
+
+/**
+ * @brief Set the range of quantized positions (positionOffset, positionScale) to the bounding box of the vertices.
+ *
+ * @param mesh Mesh to update.
+ * @param vertices Pointer to count vertices.
+ * @param count Number of vertices.
+ */
+void meshFitPositions(Mesh& mesh, const Vertex* vertices, std::size_t count);
+
+/**
+ * @brief Convert vertices to the format of the mesh and write them to its vertex buffer.
+ *
+ * @param mesh Mesh to update.
+ * @param first First vertex to overwrite.
+ * @param vertices Pointer to count vertices.
+ * @param count Number of vertices.
+ */
+void meshUploadVertices(const Mesh& mesh, std::size_t first, const Vertex* vertices, std::size_t count);
+
+/**
+ * @brief Convert indices to the index type of the mesh and write them to its index buffer.
+ *
+ * @param mesh Mesh to update.
+ * @param first First index to overwrite.
+ * @param indices Pointer to count indices.
+ * @param count Number of indices.
+ */
+void meshUploadIndices(const Mesh& mesh, std::size_t first, const unsigned int* indices, std::size_t count);
+
+/**
+ * @brief Size of one vertex in bytes.
+ *
+ * @param format Combination of eVertexFormat flags.
+ *
+ * @return Vertex stride.
+ */
+std::size_t meshVertexSize(unsigned int format);
+
+/**
+ * @brief Enable and describe the vertex attributes of a vertex format for the currently bound VAO and array buffer.
+ *
+ * @param format Combination of eVertexFormat flags.
+ */
+void meshVertexAttributes(unsigned int format);
+
+/**
+ * @brief Size of one position in the position-only stream in bytes.
+ *
+ * @param format Combination of eVertexFormat flags.
+ *
+ * @return Position stride.
+ */
+std::size_t meshPositionSize(unsigned int format);
+
+/**
+ * @brief Enable and describe the position attribute of the position-only stream for the currently bound VAO and
+ * array buffer.
+ *
+ * @param format Combination of eVertexFormat flags.
+ */
+void meshPositionAttributes(unsigned int format);
+
+/**
+ * @brief Byte offset of an index in the index buffer of a mesh, as expected by glDrawElements. Indices are relative
+ * to mesh.baseVertex, so draw calls have to use glDrawElementsBaseVertex for meshes of an arena.
+ *
+ * @param mesh Mesh.
+ * @param first Index.
+ *
+ * @return Offset cast to a pointer.
+ */
+inline const void* meshIndexOffset(const Mesh& mesh, std::size_t first)
+{
+    return (const void*) ((mesh.baseIndex + first) * (mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+}
 
 /**
- * @brief Cleanup and delete all OpenGL buffers of a mesh. Has to be called for each mesh after it is not used anymore.
+ * @brief Cleanup and delete all OpenGL buffers of a mesh (or return its ranges to the arena it was allocated from).
+ * Has to be called for each mesh after it is not used anymore.
  *
  * @param mesh Mesh to delete.
  */
@@ -1,25 +1,64 @@
 #include "model.h"
 
+#include "file.h"
+#include "modelcache.h"
+#include "threadpool.h"
+
+#include <algorithm>
 #include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
+#include <string_view>
+#include <unordered_map>
 
 namespace detail
 {
 
-void tokenize(std::string const &str, const char delim, std::vector<std::string> &out)
+/* the OBJ parser works directly on the mapped file, [cur, end) is always the rest of the current line */
+inline bool isBlank(char c)
 {
-    size_t start;
-    size_t end = 0;
+    return c == ' ' || c == '\t' || c == '\r';
+}
 
-    while( (start = str.find_first_not_of(delim, end)) != std::string::npos )
-    {
-        end = str.find(delim, start);
-        out.push_back(str.substr(start, end - start));
-    }
+inline const char* lineEnd(const char* cur, const char* end)
+{
+    const char* eol = static_cast<const char*>(std::memchr(cur, '\n', end - cur));
+    return eol ? eol : end;
+}
+
+inline std::string_view nextToken(const char*& cur, const char* end)
+{
+    while(cur < end && isBlank(*cur)) { ++cur; }
+
+    const char* start = cur;
+    while(cur < end && !isBlank(*cur)) { ++cur; }
+
+    return std::string_view(start, cur - start);
+}
+
+inline void parseFloat(const char*& cur, const char* end, float& value)
+{
+    while(cur < end && isBlank(*cur)) { ++cur; }
+
+    /* from_chars doesn't accept an explicit plus sign */
+    if(cur < end && *cur == '+') { ++cur; }
+
+    auto result = std::from_chars(cur, end, value);
+    cur = result.ptr;
+}
+
+inline bool parseInt(const char*& cur, const char* end, int& value)
+{
+    auto result = std::from_chars(cur, end, value);
+    bool ok = result.ec == std::errc();
+    cur = result.ptr;
+    return ok;
 }
 
 struct Index
@@ -31,44 +70,194 @@ struct Index
         VT = 4,
 
         V_VN = V | VN,
-        V_VT_VN = V | VN | VT
+        V_VT = V | VT,
+        V_VT_VN = V | VN | VT,
+
+        /* set while parsing chunks: the reference was negative and is relative to the start of its chunk */
+        V_RELATIVE = 8,
+        VT_RELATIVE = 16,
+        VN_RELATIVE = 32
     };
 
-    eType type = V;
-    unsigned int v = 0;
-    unsigned int vt = 0;
-    unsigned int vn = 0;
+    int type = V;
+    int v = 0;
+    int vt = 0;
+    int vn = 0;
+};
+
+/* identical (v, vt, vn) triples of one object are welded into a single vertex */
+inline bool operator==(const Index& a, const Index& b)
+{
+    return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+}
+
+struct IndexHash
+{
+    std::size_t operator()(const Index& index) const
+    {
+        std::uint64_t h = static_cast<std::uint32_t>(index.v);
+        h = h * 0x9E3779B97F4A7C15ull ^ static_cast<std::uint32_t>(index.vt);
+        h = h * 0x9E3779B97F4A7C15ull ^ static_cast<std::uint32_t>(index.vn);
+        return static_cast<std::size_t>(h ^ (h >> 29));
+    }
+};
+
+/* parse one reference, negative values are relative to the current end of the list (count elements so far) */
+inline bool parseRef(const char*& cur, const char* end, int& ref, std::size_t count, int& type, int relativeFlag)
+{
+    if(!parseInt(cur, end, ref))
+    {
+        return false;
+    }
+
+    if(ref < 0)
+    {
+        ref += static_cast<int>(count) + 1;
+        type |= relativeFlag;
+    }
+
+    return true;
+}
+
+/* parse one face corner of the form v, v/vt, v//vn or v/vt/vn */
+inline bool parseIndex(const char*& cur, const char* end, Index& index, std::size_t nv, std::size_t nvt, std::size_t nvn)
+{
+    while(cur < end && isBlank(*cur)) { ++cur; }
 
-    friend std::stringstream& operator >>(std::stringstream& in, Index& index)
+    index.type = Index::V;
+    if(!parseRef(cur, end, index.v, nv, index.type, Index::V_RELATIVE))
     {
-        std::string data;
-        in >> data;
+        return false;
+    }
 
-        std::vector<std::string> tokens;
-        tokenize(data, '/', tokens);
+    if(cur < end && *cur == '/')
+    {
+        ++cur;
+        if(parseRef(cur, end, index.vt, nvt, index.type, Index::VT_RELATIVE))
+        {
+            index.type |= Index::VT;
+        }
 
-        if(tokens.empty())
+        if(cur < end && *cur == '/')
         {
-            return in;
+            ++cur;
+            if(parseRef(cur, end, index.vn, nvn, index.type, Index::VN_RELATIVE))
+            {
+                index.type |= Index::VN;
+            }
         }
+    }
+
+    /* skip anything we don't understand up to the next corner */
+    while(cur < end && !isBlank(*cur)) { ++cur; }
+
+    return true;
+}
+
+/* commands that change the object or material state, replayed in order after all chunks are parsed */
+struct ObjCommand
+{
+    enum eType
+    {
+        Object,
+        UseMaterial,
+        MaterialLib
+    };
+
+    eType type;
+    std::string_view argument;
+    std::size_t corner;
+};
+
+/* everything parsed from one line aligned byte range of an OBJ file, face corners reference chunk local data */
+struct ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    std::vector<Vector3D> vertices;
+    std::vector<Vector3D> normals;
+    std::vector<Vector2D> uvs;
+    std::vector<Index> corners;
+    std::vector<ObjCommand> commands;
+};
+
+void parseChunk(ObjChunk& chunk)
+{
+    const char* cur = chunk.begin;
+
+    while(cur < chunk.end)
+    {
+        const char* end = lineEnd(cur, chunk.end);
+        const char* next = end < chunk.end ? end + 1 : chunk.end;
+
+        /* command code */
+        std::string_view code = nextToken(cur, end);
 
-        index.v = std::stoi( tokens[0] );
+        if(code.empty() || code.front() == '#')
+        {
+            /* empty line or comment */
+        }
+        /* create new object */
+        else if(code == "o")
+        {
+            chunk.commands.push_back({ObjCommand::Object, nextToken(cur, end), chunk.corners.size()});
+        }
+        /* vertex postion */
+        else if(code == "v")
+        {
+            auto& v = chunk.vertices.emplace_back();
+            parseFloat(cur, end, v.x);
+            parseFloat(cur, end, v.y);
+            parseFloat(cur, end, v.z);
+        }
+        /* vertex texture coordinates */
+        else if(code == "vt")
+        {
+            auto& vt = chunk.uvs.emplace_back();
+            parseFloat(cur, end, vt.x);
+            parseFloat(cur, end, vt.y);
+        }
+        /* vertex normal */
+        else if(code == "vn")
+        {
+            auto& vn = chunk.normals.emplace_back();
+            parseFloat(cur, end, vn.x);
+            parseFloat(cur, end, vn.y);
+            parseFloat(cur, end, vn.z);
+        }
+        /* face definition (currently only triangles) */
+        else if(code == "f")
+        {
+            Index _idx[3];
+            int corners = 0;
+            while(corners < 3 && parseIndex(cur, end, _idx[corners], chunk.vertices.size(), chunk.uvs.size(), chunk.normals.size()))
+            {
+                corners++;
+            }
 
-        if(tokens.size() == 2)
+            if(corners == 3)
+            {
+                chunk.corners.insert(chunk.corners.end(), _idx, _idx + 3);
+            }
+        }
+        /* load material file (path in respect to .obj file) */
+        else if(code == "mtllib")
         {
-            index.vn = std::stoi( tokens[1] );
-            index.type = V_VN;
+            chunk.commands.push_back({ObjCommand::MaterialLib, nextToken(cur, end), chunk.corners.size()});
         }
-        else if(tokens.size() == 3)
+        /* switch to material for next face definitions */
+        else if(code == "usemtl")
         {
-            index.vt = std::stoi( tokens[1] );
-            index.vn = std::stoi( tokens[2] );
-            index.type = V_VT_VN;
+            chunk.commands.push_back({ObjCommand::UseMaterial, nextToken(cur, end), chunk.corners.size()});
         }
 
-        return in;
+        cur = next;
     }
-};
+}
+
+/* chunks only pay off if every thread gets a decent amount of work */
+constexpr std::size_t minChunkSize = 1 << 20;
 
 }
 
@@ -135,137 +324,231 @@ std::map<std::string, Material> materialLoad(const std::string &filepath)
     return materials;
 }
 
-std::vector<Model> modelLoad(const std::string &filepath)
+std::vector<ModelData> modelParse(const std::string &filepath, std::vector<std::string>* sources, unsigned int threads)
 {
-    std::ifstream objFile(filepath);
-    if(!objFile.is_open())
+    MappedFile objFile = mappedFileOpen(filepath);
+    if(sources)
     {
-        throw std::runtime_error("[Model] Couldn't open OBJ file at " + filepath);
+        sources->push_back(filepath);
     }
 
-    /* container for GL related stuff */
-    std::vector<Model> models;
-    std::vector<Vertex> glVertices;
-    std::vector<unsigned int> glIndices;
+    /* parsed objects */
+    std::vector<ModelData> models;
 
-    /* container for OBJ related stuff */
-    std::map<std::string, Material> materials;
-    std::vector<Vector3D> vertices;
-    std::vector<Vector3D> normals;
-    std::vector<Vector2D> uvs;
+    try
+    {
+        /* split the file into line aligned ranges */
+        if(threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        std::size_t chunkCount = std::clamp<std::size_t>(objFile.size / detail::minChunkSize, 1, threads);
 
+        std::vector<detail::ObjChunk> chunks(chunkCount);
+        const char* const fileEnd = objFile.data + objFile.size;
+        const char* cur = objFile.data;
+        for(std::size_t i = 0; i < chunkCount; i++)
+        {
+            const char* end = i + 1 == chunkCount ? fileEnd : objFile.data + objFile.size * (i + 1) / chunkCount;
+            end = std::max(end, cur);
+            end = end < fileEnd ? detail::lineEnd(end, fileEnd) : fileEnd;
+            end = end < fileEnd ? end + 1 : fileEnd;
+
+            chunks[i].begin = cur;
+            chunks[i].end = end;
+            cur = end;
+        }
 
-    /* consume commonds from obj file */
-    std::string line;
-    while(std::getline(objFile, line))
-    {
-        std::stringstream ss(line);
+        /* parse all but the first chunk on the pool, the first one on this thread */
+        ThreadPool* pool = threadPoolShared();
+        std::vector<std::future<void>> pending;
+        for(std::size_t i = 1; i < chunkCount; i++)
+        {
+            pending.push_back(threadPoolSubmit(pool, [&chunk = chunks[i]]() { detail::parseChunk(chunk); }));
+        }
 
-        /* command code */
-        std::string code;
-        ss >> code;
+        detail::parseChunk(chunks.front());
 
-        if(code == "")
+        for(auto& p : pending)
         {
-            continue;
+            threadPoolWait(pool, p);
         }
-        /* create new object */
-        else if(code == "o")
+        for(auto& p : pending)
         {
-            if(!models.empty())
-            {
-                Model& model = models.back();
-                model.mesh = meshCreate(glVertices, glIndices);
+            p.get();
+        }
 
-                if(!model.material.empty())
-                {
-                    auto& material = model.material.back();
-                    material.indexCount = glVertices.size() - material.indexOffset;
-                }
+        /* stitch the chunk arrays together, face corners are resolved against the global arrays below */
+        std::vector<Vector3D> vertices;
+        std::vector<Vector3D> normals;
+        std::vector<Vector2D> uvs;
+        std::vector<std::size_t> vertexBase, normalBase, uvBase;
+        for(auto& chunk : chunks)
+        {
+            vertexBase.push_back(vertices.size());
+            normalBase.push_back(normals.size());
+            uvBase.push_back(uvs.size());
 
-                glVertices.clear();
-                glIndices.clear();
-            }
+            vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+            normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+            uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
 
-            Model& model = models.emplace_back();
-            ss >> model.name;
+            chunk.vertices = {};
+            chunk.normals = {};
+            chunk.uvs = {};
         }
-        /* vertex postion */
-        else if(code == "v")
+
+        /* serial pass: replay object/material commands and weld the face corners of each object */
+        std::map<std::string, Material> materials;
+        std::unordered_map<detail::Index, unsigned int, detail::IndexHash> welded;
+
+        auto currentModel = [&]() -> ModelData&
         {
-            auto& v = vertices.emplace_back();
-            ss >> v.x >> v.y >> v.z;
-        }
-        /* vertex texture coordinates */
-        else if(code == "vt")
+            /* geometry before the first 'o' goes to an unnamed object */
+            return models.empty() ? models.emplace_back() : models.back();
+        };
+
+        auto finishModel = [&](ModelData& model)
         {
-            auto& vt = uvs.emplace_back();
-            ss >> vt.x >> vt.y;
-        }
-        /* vertex normal */
-        else if(code == "vn")
+            if(!model.material.empty())
+            {
+                auto& material = model.material.back();
+                material.indexCount = model.indices.size() - material.indexOffset;
+            }
+
+            welded.clear();
+        };
+
+        auto addCorner = [&](const detail::ObjChunk& chunk, std::size_t c, std::size_t chunkIndex)
         {
-            auto& vn = normals.emplace_back();
-            ss >> vn.x >> vn.y >> vn.z;
-        }
-        /* face definition (currently only triangles) */
-        else if(code == "f")
+            detail::Index index = chunk.corners[c];
+            index.v += (index.type & detail::Index::V_RELATIVE) ? vertexBase[chunkIndex] : 0;
+            index.vt += (index.type & detail::Index::VT_RELATIVE) ? uvBase[chunkIndex] : 0;
+            index.vn += (index.type & detail::Index::VN_RELATIVE) ? normalBase[chunkIndex] : 0;
+
+            bool valid = index.v >= 1 && static_cast<std::size_t>(index.v) <= vertices.size() &&
+                         (!(index.type & detail::Index::VT) || (index.vt >= 1 && static_cast<std::size_t>(index.vt) <= uvs.size())) &&
+                         (!(index.type & detail::Index::VN) || (index.vn >= 1 && static_cast<std::size_t>(index.vn) <= normals.size()));
+            if(!valid)
+            {
+                throw std::runtime_error("[Model] Invalid face index in OBJ file " + filepath);
+            }
+
+            ModelData& model = currentModel();
+
+            /* reuse the vertex if this corner was already emitted for the current object */
+            auto [it, inserted] = welded.try_emplace(index, static_cast<unsigned int>(model.vertices.size()));
+            model.indices.emplace_back(it->second);
+            if(!inserted)
+            {
+                return;
+            }
+
+            Vertex& vertex = model.vertices.emplace_back();
+            vertex.pos = vertices[index.v - 1];
+
+            if(index.type & detail::Index::VN)
+            {
+                vertex.normal = normals[index.vn - 1];
+            }
+            if(index.type & detail::Index::VT)
+            {
+                vertex.uv = uvs[index.vt - 1];
+            }
+        };
+
+        for(std::size_t i = 0; i < chunkCount; i++)
         {
-            detail::Index _idx[3];
-            ss >> _idx[0] >> _idx[1] >> _idx[2];
+            const auto& chunk = chunks[i];
+            std::size_t corner = 0;
 
-            for(int i = 0; i < 3; i++)
+            for(const auto& command : chunk.commands)
             {
-                glIndices.emplace_back(glVertices.size());
+                for(; corner < command.corner; corner++)
+                {
+                    addCorner(chunk, corner, i);
+                }
 
-                Vertex& vertex = glVertices.emplace_back();
-                vertex.pos = vertices[_idx[i].v - 1];
+                /* create new object */
+                if(command.type == detail::ObjCommand::Object)
+                {
+                    if(!models.empty())
+                    {
+                        finishModel(models.back());
+                    }
 
-                if(_idx[i].type == detail::Index::V_VN)
+                    ModelData& model = models.emplace_back();
+                    model.name = command.argument;
+                }
+                /* load material file (path in respect to .obj file) */
+                else if(command.type == detail::ObjCommand::MaterialLib)
                 {
-                    vertex.normal = normals[_idx[i].vn - 1];
+                    std::string file = filepath.substr(0, filepath.find_last_of("\\/")) + "/" + std::string(command.argument);
+                    materials = materialLoad(file);
+                    if(sources)
+                    {
+                        sources->push_back(file);
+                    }
                 }
-                else if(_idx[i].type == detail::Index::V_VT_VN)
+                /* switch to material for next face definitions */
+                else if(command.type == detail::ObjCommand::UseMaterial)
                 {
-                    vertex.normal = normals[_idx[i].vn - 1];
-                    vertex.uv = uvs[_idx[i].vt - 1];
+                    auto& model = currentModel();
+
+                    if(!model.material.empty())
+                    {
+                        auto& material = model.material.back();
+                        material.indexCount = model.indices.size() - material.indexOffset;
+                    }
+
+                    auto& material = model.material.emplace_back( materials[std::string(command.argument)] );
+                    material.indexOffset = model.indices.size();
                 }
             }
-        }
-        /* load material file (path in respect to .obj file) */
-        else if(code == "mtllib")
-        {
-            std::string file;
-            ss >> file;
-            materials = materialLoad( filepath.substr(0, filepath.find_last_of("\\/")) + "/" + file );
-        }
-        /* switch to material for next face definitions */
-        else if(code == "usemtl")
-        {
-            auto& model = models.back();
-            std::string name;
-            ss >> name;
 
-            if(!model.material.empty())
+            for(; corner < chunk.corners.size(); corner++)
             {
-                auto& material = model.material.back();
-                material.indexCount = glVertices.size() - material.indexOffset;
+                addCorner(chunk, corner, i);
             }
+        }
 
-            auto& material = model.material.emplace_back( materials[name] );
-            material.indexOffset = glVertices.size();
+        /* finish up last object */
+        if(!models.empty())
+        {
+            finishModel(models.back());
         }
     }
+    catch(...)
+    {
+        mappedFileClose(objFile);
+        throw;
+    }
+
+    mappedFileClose(objFile);
+
+    return models;
+}
 
-    /* finnish up last object */
-    Model& model = models.back();
-    model.mesh = meshCreate(glVertices, glIndices);
-    if(!model.material.empty())
+Model modelCreate(const ModelData &data, unsigned int format)
+{
+    return Model{meshCreate(data.vertices, data.indices, format), data.name, data.material, data.lod, data.bounds};
+}
+
+std::vector<Model> modelLoad(const std::string &filepath, const ModelLoadOptions &options)
+{
+    ModelSource source;
+    modelSourceLoad(filepath, options, source);
+
+    /* the source either points into the mapped cache or into the parsed data, upload without copying */
+    std::vector<Model> models;
+    for(const auto& entry : source.models)
     {
-        auto& material = model.material.back();
-        material.indexCount = glVertices.size() - material.indexOffset;
+        Mesh mesh = options.arena ? meshArenaAlloc(*options.arena, entry.vertices, entry.vertexCount, entry.indices, entry.indexCount)
+                                  : meshCreate(entry.vertices, entry.vertexCount, entry.indices, entry.indexCount, options.vertexFormat);
+        models.push_back(modelCacheEntryModel(entry, mesh));
     }
 
+    modelSourceClose(source);
     return models;
 }
 
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "arena.h"
+#include "bounds.h"
 #include "mesh.h"
 
+#include <map>
+
 struct Material
 {
     std::string name;
@@ -14,6 +18,17 @@ struct Material
 
     unsigned int indexOffset;
     unsigned int indexCount;
+
+    /* bounds of the triangles of the range in object space (levels keep the bounds of the full range) */
+    Bounds bounds;
+};
+
+/* simplified level of a model, same materials as the full model but with index ranges of fewer triangles */
+struct ModelLod
+{
+    /* largest geometric error (object space distance) introduced by the simplification */
+    float error = 0.0f;
+    std::vector<Material> material;
 };
 
 struct Model
@@ -21,8 +36,88 @@ struct Model
     Mesh mesh;
     std::string name;
     std::vector<Material> material;
+
+    /* increasingly coarse levels sharing the vertex and index buffer of the mesh (see lod.h) */
+    std::vector<ModelLod> lod;
+
+    /* bounds of all vertices in object space */
+    Bounds bounds;
+};
+
+/* CPU side of a model (geometry and materials), before it is uploaded to OpenGL */
+struct ModelData
+{
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Material> material;
+
+    std::vector<ModelLod> lod;
+    Bounds bounds;
 };
 
-std::vector<Model> modelLoad(const std::string &filepath);
+struct ModelLoadOptions
+{
+    /* read and write the binary cache next to the OBJ file (see modelcache.h) */
+    bool useCache = true;
+
+    /* number of threads used to parse large OBJ files (0 = one per hardware thread) */
+    unsigned int threads = 0;
+
+    /* reorder triangles and vertices for the post-transform cache and less overdraw (see optimize.h) */
+    bool optimize = false;
+
+    /* number of simplified levels generated per model (see lod.h) */
+    unsigned int lodLevels = 0;
+
+    /* layout the vertices are stored with on the GPU (combination of eVertexFormat flags) */
+    unsigned int vertexFormat = VertexFloat;
+
+    /* if set, the meshes are sub-allocated from this arena and use its vertex format instead (see arena.h) */
+    MeshArena* arena = nullptr;
+};
+
+/**
+ * @brief Load all objects of an OBJ file and upload them to OpenGL. The parsed result is stored in a binary cache
+ * next to the OBJ file and reused as long as the OBJ and its material files are unchanged.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param options Loader options.
+ *
+ * @return One model per object of the file.
+ */
+std::vector<Model> modelLoad(const std::string &filepath, const ModelLoadOptions& options = {});
+
+/**
+ * @brief Parse all objects of an OBJ file (and its material files) without touching OpenGL. Large files are split
+ * into line aligned chunks that are parsed in parallel, the result is the same for any number of threads.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param sources If not null, receives the paths of all files the result depends on (the OBJ and its MTL files).
+ * @param threads Maximum number of threads used for parsing (0 = one per hardware thread).
+ *
+ * @return One model data entry per object of the file.
+ */
+std::vector<ModelData> modelParse(const std::string &filepath, std::vector<std::string>* sources = nullptr, unsigned int threads = 0);
+
+/**
+ * @brief Parse the materials of an MTL file, e.g. for geometry that doesn't come from an OBJ file.
+ *
+ * @param filepath Path to the MTL file.
+ *
+ * @return Materials by name (without index ranges).
+ */
+std::map<std::string, Material> materialLoad(const std::string &filepath);
+
+/**
+ * @brief Upload parsed model data to OpenGL.
+ *
+ * @param data Parsed model data.
+ * @param format Combination of eVertexFormat flags the vertices are stored with on the GPU.
+ *
+ * @return Model that can be drawn with OpenGL.
+ */
+Model modelCreate(const ModelData& data, unsigned int format = VertexFloat);
+
 void modelDelete(std::vector<Model>& models);
 void modelDelete(Model& model);
@@ -0,0 +1,496 @@
+#include "modelcache.h"
+
+#include "lod.h"
+#include "optimize.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+/*
+ * Cache file layout (native endianness, everything tightly packed unless noted):
+ *
+ *   header   magic[8], version, sizeof(Vertex), flags, source count, model count
+ *   sources  per source: path (relative to the directory of the cache file), size, modification time, content hash
+ *   models   per model: name, vertex count, index count, bounding sphere, materials, levels (error and materials)
+ *   data     per model: vertices, then indices, each starting at a 16 byte aligned offset
+ *
+ * Strings are stored as uint32 length followed by the characters.
+ */
+
+namespace detail
+{
+
+constexpr char cacheMagic[8] = {'M', 'Y', 'G', 'L', 'M', 'D', 'L', '\0'};
+constexpr std::uint32_t cacheVersion = 5;
+constexpr std::size_t cacheAlignment = 16;
+
+inline std::size_t alignUp(std::size_t value, std::size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+struct SourceInfo
+{
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    std::uint64_t hash = 0;
+};
+
+bool sourceStat(const std::string& path, SourceInfo& info)
+{
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if(ec)
+    {
+        return false;
+    }
+
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if(ec)
+    {
+        return false;
+    }
+
+    info.size = size;
+    info.mtime = static_cast<std::int64_t>(mtime.time_since_epoch().count());
+    return true;
+}
+
+/* sources are stored relative to the cache, so the cache stays valid when the program runs from another directory */
+std::filesystem::path cacheDirectory(const std::string& cachePath)
+{
+    return std::filesystem::absolute(cachePath).parent_path();
+}
+
+std::string sourceRelative(const std::string& path, const std::filesystem::path& directory)
+{
+    std::filesystem::path relative = std::filesystem::absolute(path).lexically_relative(directory);
+    return relative.empty() ? std::filesystem::absolute(path).generic_string() : relative.generic_string();
+}
+
+std::string sourceResolve(const std::string& path, const std::filesystem::path& directory)
+{
+    return (directory / path).lexically_normal().string();
+}
+
+std::uint64_t sourceHash(const std::string& path)
+{
+    MappedFile file = mappedFileOpen(path);
+    std::uint64_t hash = hashBytes(file.data, file.size);
+    mappedFileClose(file);
+    return hash;
+}
+
+/* position of the modification time of a source in the cache file and the time it has now */
+struct MtimeUpdate
+{
+    std::size_t offset = 0;
+    std::int64_t mtime = 0;
+};
+
+/* sources whose content is unchanged but whose modification time changed (e.g. after a checkout) get the new time, so
+   the next start doesn't hash them again. Failing is harmless, the content is hashed again next time. */
+void updateMtimes(const std::string& cachePath, const std::vector<MtimeUpdate>& updates)
+{
+    if(updates.empty())
+    {
+        return;
+    }
+
+    std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+    for(const auto& update : updates)
+    {
+        file.seekp(static_cast<std::streamoff>(update.offset));
+        file.write(reinterpret_cast<const char*>(&update.mtime), sizeof(update.mtime));
+    }
+}
+
+struct Writer
+{
+    std::string buffer;
+
+    template<typename T>
+    void put(const T& value)
+    {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void put(const std::string& str)
+    {
+        put(static_cast<std::uint32_t>(str.size()));
+        buffer.append(str);
+    }
+
+    void put(const Vector3D& v)
+    {
+        put(v.x);
+        put(v.y);
+        put(v.z);
+    }
+
+    void put(const Bounds& bounds)
+    {
+        put(bounds.min);
+        put(bounds.max);
+        put(bounds.center);
+        put(bounds.radius);
+    }
+
+    void put(const std::vector<Material>& materials)
+    {
+        put(static_cast<std::uint32_t>(materials.size()));
+        for(const auto& material : materials)
+        {
+            put(material.name);
+            put(material.emission);
+            put(material.ambient);
+            put(material.diffuse);
+            put(material.specular);
+            put(material.shininess);
+            put(material.indexOffset);
+            put(material.indexCount);
+            put(material.bounds);
+        }
+    }
+
+    void align()
+    {
+        buffer.resize(alignUp(buffer.size(), cacheAlignment), '\0');
+    }
+};
+
+struct Reader
+{
+    const char* begin;
+    const char* cur;
+    const char* end;
+    bool ok = true;
+
+    template<typename T>
+    void get(T& value)
+    {
+        if(static_cast<std::size_t>(end - cur) < sizeof(T))
+        {
+            ok = false;
+            return;
+        }
+
+        std::memcpy(&value, cur, sizeof(T));
+        cur += sizeof(T);
+    }
+
+    void get(std::string& str)
+    {
+        std::uint32_t length = 0;
+        get(length);
+        if(!ok || static_cast<std::size_t>(end - cur) < length)
+        {
+            ok = false;
+            return;
+        }
+
+        str.assign(cur, length);
+        cur += length;
+    }
+
+    void get(Vector3D& v)
+    {
+        get(v.x);
+        get(v.y);
+        get(v.z);
+    }
+
+    void get(Bounds& bounds)
+    {
+        get(bounds.min);
+        get(bounds.max);
+        get(bounds.center);
+        get(bounds.radius);
+    }
+
+    /* materials with index ranges inside [0, indexCount) */
+    void get(std::vector<Material>& materials, std::uint32_t indexCount)
+    {
+        std::uint32_t count = 0;
+        get(count);
+
+        for(std::uint32_t m = 0; ok && m < count; m++)
+        {
+            auto& material = materials.emplace_back();
+            get(material.name);
+            get(material.emission);
+            get(material.ambient);
+            get(material.diffuse);
+            get(material.specular);
+            get(material.shininess);
+            get(material.indexOffset);
+            get(material.indexCount);
+            get(material.bounds);
+
+            ok = ok && material.indexOffset <= indexCount && material.indexCount <= indexCount - material.indexOffset;
+        }
+    }
+
+    /* reserve count elements of T at the next aligned position and return a pointer into the mapping */
+    template<typename T>
+    const T* block(std::size_t count)
+    {
+        std::size_t offset = alignUp(cur - begin, cacheAlignment);
+        if(offset > static_cast<std::size_t>(end - begin) || (end - begin - offset) / sizeof(T) < count)
+        {
+            ok = false;
+            return nullptr;
+        }
+
+        cur = begin + offset + count * sizeof(T);
+        return reinterpret_cast<const T*>(begin + offset);
+    }
+};
+
+}
+
+Model modelCacheEntryModel(const ModelCacheEntry &entry, const Mesh &mesh)
+{
+    return Model{mesh, entry.name, entry.material, entry.lod, entry.bounds};
+}
+
+std::string modelCachePath(const std::string &filepath)
+{
+    return filepath + ".cache";
+}
+
+bool modelCacheOpen(const std::string &cachePath, ModelCache &cache, std::uint32_t flags)
+{
+    std::error_code ec;
+    if(!std::filesystem::is_regular_file(cachePath, ec))
+    {
+        return false;
+    }
+
+    try
+    {
+        cache.file = mappedFileOpen(cachePath);
+        cache.models.clear();
+
+        detail::Reader in{cache.file.data, cache.file.data, cache.file.data + cache.file.size};
+
+        char magic[8] = {};
+        std::uint32_t version = 0, vertexSize = 0, storedFlags = 0, sourceCount = 0, modelCount = 0;
+        in.get(magic);
+        in.get(version);
+        in.get(vertexSize);
+        in.get(storedFlags);
+        in.get(sourceCount);
+        in.get(modelCount);
+
+        bool valid = in.ok && std::memcmp(magic, detail::cacheMagic, sizeof(magic)) == 0 &&
+                     version == detail::cacheVersion && vertexSize == sizeof(Vertex) && storedFlags == flags;
+
+        /* check all sources, only hash the content if the modification time changed */
+        std::filesystem::path directory = detail::cacheDirectory(cachePath);
+        std::vector<detail::MtimeUpdate> touched;
+        for(std::uint32_t i = 0; valid && i < sourceCount; i++)
+        {
+            std::string path;
+            detail::SourceInfo stored, current;
+            in.get(path);
+            in.get(stored.size);
+            std::size_t mtimeOffset = in.cur - in.begin;
+            in.get(stored.mtime);
+            in.get(stored.hash);
+            path = detail::sourceResolve(path, directory);
+
+            valid = in.ok && detail::sourceStat(path, current) && current.size == stored.size;
+            if(valid && current.mtime != stored.mtime)
+            {
+                valid = detail::sourceHash(path) == stored.hash;
+                touched.push_back(detail::MtimeUpdate{mtimeOffset, current.mtime});
+            }
+        }
+
+        for(std::uint32_t i = 0; valid && i < modelCount; i++)
+        {
+            auto& entry = cache.models.emplace_back();
+            std::uint32_t lodCount = 0;
+            in.get(entry.name);
+            in.get(entry.vertexCount);
+            in.get(entry.indexCount);
+            in.get(entry.bounds);
+            in.get(entry.material, entry.indexCount);
+            in.get(lodCount);
+
+            for(std::uint32_t l = 0; in.ok && l < lodCount; l++)
+            {
+                auto& lod = entry.lod.emplace_back();
+                in.get(lod.error);
+                in.get(lod.material, entry.indexCount);
+            }
+
+            valid = in.ok;
+        }
+
+        for(auto& entry : cache.models)
+        {
+            entry.vertices = in.block<Vertex>(entry.vertexCount);
+            entry.indices = in.block<unsigned int>(entry.indexCount);
+        }
+
+        if(valid && in.ok)
+        {
+            detail::updateMtimes(cachePath, touched);
+            return true;
+        }
+    }
+    catch(const std::exception&)
+    {
+        /* an unreadable cache is treated like a missing one */
+    }
+
+    modelCacheClose(cache);
+    return false;
+}
+
+void modelCacheClose(ModelCache &cache)
+{
+    mappedFileClose(cache.file);
+    cache.models.clear();
+}
+
+void modelCacheWrite(const std::string &cachePath, const std::vector<ModelData> &models, const std::vector<std::string> &sources, std::uint32_t flags)
+{
+    detail::Writer out;
+
+    try
+    {
+        out.buffer.append(detail::cacheMagic, sizeof(detail::cacheMagic));
+        out.put(detail::cacheVersion);
+        out.put(static_cast<std::uint32_t>(sizeof(Vertex)));
+        out.put(flags);
+        out.put(static_cast<std::uint32_t>(sources.size()));
+        out.put(static_cast<std::uint32_t>(models.size()));
+
+        std::filesystem::path directory = detail::cacheDirectory(cachePath);
+        for(const auto& path : sources)
+        {
+            detail::SourceInfo info;
+            if(!detail::sourceStat(path, info))
+            {
+                throw std::runtime_error("missing source " + path);
+            }
+            info.hash = detail::sourceHash(path);
+
+            out.put(detail::sourceRelative(path, directory));
+            out.put(info.size);
+            out.put(info.mtime);
+            out.put(info.hash);
+        }
+
+        for(const auto& model : models)
+        {
+            out.put(model.name);
+            out.put(static_cast<std::uint32_t>(model.vertices.size()));
+            out.put(static_cast<std::uint32_t>(model.indices.size()));
+            out.put(model.bounds);
+            out.put(model.material);
+            out.put(static_cast<std::uint32_t>(model.lod.size()));
+
+            for(const auto& lod : model.lod)
+            {
+                out.put(lod.error);
+                out.put(lod.material);
+            }
+        }
+
+        for(const auto& model : models)
+        {
+            out.align();
+            out.buffer.append(reinterpret_cast<const char*>(model.vertices.data()), model.vertices.size() * sizeof(Vertex));
+            out.align();
+            out.buffer.append(reinterpret_cast<const char*>(model.indices.data()), model.indices.size() * sizeof(unsigned int));
+        }
+
+        /* write to a temporary file first, so a crash never leaves a half written cache behind */
+        std::string tmpPath = cachePath + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            file.write(out.buffer.data(), static_cast<std::streamsize>(out.buffer.size()));
+            if(!file)
+            {
+                throw std::runtime_error("write failed");
+            }
+        }
+
+        std::filesystem::rename(tmpPath, cachePath);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "[ModelCache] Couldn't write cache file at " << cachePath << " (" << e.what() << ")" << std::endl;
+    }
+}
+
+std::uint32_t modelCacheFlags(const ModelLoadOptions &options)
+{
+    return (options.optimize ? 1u : 0u) | options.lodLevels << 8;
+}
+
+void modelSourceLoad(const std::string &filepath, const ModelLoadOptions &options, ModelSource &source)
+{
+    std::string cachePath = modelCachePath(filepath);
+    std::uint32_t flags = modelCacheFlags(options);
+
+    /* fast path: the entries of the mapped cache already point at the data */
+    if(options.useCache && modelCacheOpen(cachePath, source.cache, flags))
+    {
+        source.models = source.cache.models;
+        return;
+    }
+
+    std::vector<std::string> sources;
+    source.data = modelParse(filepath, &sources, options.threads);
+
+    for(auto& data : source.data)
+    {
+        modelComputeBounds(data);
+        if(options.lodLevels > 0)
+        {
+            modelGenerateLods(data, options.lodLevels);
+        }
+    }
+
+    if(options.optimize)
+    {
+        for(auto& data : source.data)
+        {
+            MeshOptimizeStats stats = meshOptimize(data);
+            std::cout << "[Model] Optimized " << data.name << ", ACMR " << stats.acmrBefore << " -> " << stats.acmrAfter << std::endl;
+        }
+    }
+
+    if(options.useCache)
+    {
+        modelCacheWrite(cachePath, source.data, sources, flags);
+    }
+
+    for(const auto& data : source.data)
+    {
+        ModelCacheEntry& entry = source.models.emplace_back();
+        entry.name = data.name;
+        entry.material = data.material;
+        entry.lod = data.lod;
+        entry.bounds = data.bounds;
+        entry.vertices = data.vertices.data();
+        entry.vertexCount = static_cast<unsigned int>(data.vertices.size());
+        entry.indices = data.indices.data();
+        entry.indexCount = static_cast<unsigned int>(data.indices.size());
+    }
+}
+
+void modelSourceClose(ModelSource &source)
+{
+    modelCacheClose(source.cache);
+    source.data.clear();
+    source.models.clear();
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "file.h"
+#include "model.h"
+
+#include <cstdint>
+#include <vector>
+
+/* one object inside a mapped cache file (or a parsed ModelData), vertices and indices point directly into it */
+struct ModelCacheEntry
+{
+    std::string name;
+    std::vector<Material> material;
+    std::vector<ModelLod> lod;
+    Bounds bounds;
+
+    const Vertex* vertices = nullptr;
+    unsigned int vertexCount = 0;
+    const unsigned int* indices = nullptr;
+    unsigned int indexCount = 0;
+};
+
+struct ModelCache
+{
+    MappedFile file;
+    std::vector<ModelCacheEntry> models;
+};
+
+/**
+ * @brief Model for an entry (name, materials, levels, bounds) with an already created mesh.
+ *
+ * @param entry Cache entry.
+ * @param mesh Mesh created from the vertices and indices of the entry.
+ *
+ * @return Model that can be drawn with OpenGL.
+ */
+Model modelCacheEntryModel(const ModelCacheEntry& entry, const Mesh& mesh);
+
+/**
+ * @brief Path of the binary cache that belongs to an OBJ file (stored next to it).
+ *
+ * @param filepath Path to the OBJ file.
+ *
+ * @return Path to the cache file.
+ */
+std::string modelCachePath(const std::string& filepath);
+
+/**
+ * @brief Map a cache file and check that it is still up to date. A source counts as unchanged if its size and
+ * modification time match, or if its size and content hash match.
+ *
+ * @param cachePath Path to the cache file.
+ * @param cache Receives the mapped cache on success.
+ * @param flags Processing flags the cache has to be written with (see modelCacheFlags).
+ *
+ * @return False if the cache doesn't exist, is corrupt, was written with other flags or one of its sources changed.
+ */
+bool modelCacheOpen(const std::string& cachePath, ModelCache& cache, std::uint32_t flags = 0);
+
+/**
+ * @brief Unmap a cache file. All vertex and index pointers of the entries become invalid.
+ *
+ * @param cache Cache to close.
+ */
+void modelCacheClose(ModelCache& cache);
+
+/**
+ * @brief Write parsed models to a cache file. Failing to write the cache is not an error, only a warning is printed.
+ *
+ * @param cachePath Path to the cache file.
+ * @param models Parsed model data.
+ * @param sources Files the model data was parsed from (see modelParse).
+ * @param flags Processing flags the model data was created with (see modelCacheFlags).
+ */
+void modelCacheWrite(const std::string& cachePath, const std::vector<ModelData>& models, const std::vector<std::string>& sources, std::uint32_t flags = 0);
+
+/**
+ * @brief Processing steps of the loader options that change the cached data, stored in the cache header.
+ *
+ * @param options Loader options.
+ *
+ * @return Flags for modelCacheOpen/modelCacheWrite.
+ */
+std::uint32_t modelCacheFlags(const ModelLoadOptions& options);
+
+/* CPU side result of loading an OBJ file, backed either by a mapped cache file or by freshly parsed data */
+struct ModelSource
+{
+    ModelCache cache;
+    std::vector<ModelData> data;
+
+    /* one entry per object, pointing into cache or data */
+    std::vector<ModelCacheEntry> models;
+};
+
+/**
+ * @brief Load an OBJ file up to the point where it can be uploaded: map its cache if it is up to date, otherwise
+ * parse it (and write the cache). Does not touch OpenGL, so it can run on any thread.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param options Loader options.
+ * @param source Receives the loaded data.
+ */
+void modelSourceLoad(const std::string& filepath, const ModelLoadOptions& options, ModelSource& source);
+
+/**
+ * @brief Release the data of a model source (unmaps the cache).
+ *
+ * @param source Model source to close.
+ */
+void modelSourceClose(ModelSource& source);
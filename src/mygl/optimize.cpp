@@ -0,0 +1,336 @@
+#include "optimize.h"
+
+#include <algorithm>
+#include <deque>
+#include <numeric>
+
+namespace detail
+{
+
+struct Adjacency
+{
+    /* triangles of vertex v are triangles[offset[v] .. offset[v + 1]) */
+    std::vector<unsigned int> offset;
+    std::vector<unsigned int> triangles;
+};
+
+Adjacency buildAdjacency(const unsigned int* indices, std::size_t triangleCount, std::size_t vertexCount)
+{
+    Adjacency adjacency;
+    adjacency.offset.assign(vertexCount + 1, 0);
+    adjacency.triangles.resize(triangleCount * 3);
+
+    for(std::size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacency.offset[indices[i] + 1]++;
+    }
+    std::partial_sum(adjacency.offset.begin(), adjacency.offset.end(), adjacency.offset.begin());
+
+    std::vector<unsigned int> fill(adjacency.offset.begin(), adjacency.offset.end() - 1);
+    for(std::size_t t = 0; t < triangleCount; t++)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            adjacency.triangles[fill[indices[3 * t + c]]++] = static_cast<unsigned int>(t);
+        }
+    }
+
+    return adjacency;
+}
+
+/*
+ * Tipsify from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007).
+ * Returns the new triangle order and appends the positions in it where the walk hit a dead end (cluster boundaries).
+ */
+std::vector<unsigned int> tipsify(const unsigned int* indices, std::size_t triangleCount, std::size_t vertexCount, unsigned int cacheSize, std::vector<std::size_t>& clusters)
+{
+    Adjacency adjacency = buildAdjacency(indices, triangleCount, vertexCount);
+
+    std::vector<unsigned int> live(vertexCount);
+    for(std::size_t v = 0; v < vertexCount; v++)
+    {
+        live[v] = adjacency.offset[v + 1] - adjacency.offset[v];
+    }
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> order;
+    order.reserve(triangleCount);
+
+    unsigned int timestamp = cacheSize + 1;
+    std::size_t cursor = 0;
+    long fanning = triangleCount > 0 ? static_cast<long>(indices[0]) : -1;
+
+    clusters.push_back(0);
+
+    while(fanning >= 0)
+    {
+        candidates.clear();
+
+        for(unsigned int a = adjacency.offset[fanning]; a < adjacency.offset[fanning + 1]; a++)
+        {
+            unsigned int t = adjacency.triangles[a];
+            if(emitted[t])
+            {
+                continue;
+            }
+
+            for(int c = 0; c < 3; c++)
+            {
+                unsigned int v = indices[3 * t + c];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if(timestamp - cacheTime[v] > cacheSize)
+                {
+                    cacheTime[v] = timestamp++;
+                }
+            }
+
+            emitted[t] = true;
+            order.push_back(t);
+        }
+
+        /* next fanning vertex: the candidate that stays in the cache longest while still having triangles left */
+        long best = -1;
+        int bestPriority = -1;
+        for(unsigned int v : candidates)
+        {
+            if(live[v] == 0)
+            {
+                continue;
+            }
+
+            int priority = 0;
+            if(timestamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+            {
+                priority = static_cast<int>(timestamp - cacheTime[v]);
+            }
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        if(best < 0)
+        {
+            /* dead end: continue with a recently used vertex, or scan for any vertex with triangles left */
+            while(!deadEnd.empty() && best < 0)
+            {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if(live[v] > 0)
+                {
+                    best = v;
+                }
+            }
+
+            while(best < 0 && cursor < triangleCount * 3)
+            {
+                unsigned int v = indices[cursor++];
+                if(live[v] > 0)
+                {
+                    best = v;
+                }
+            }
+
+            if(best >= 0 && clusters.back() != order.size())
+            {
+                clusters.push_back(order.size());
+            }
+        }
+
+        fanning = best;
+    }
+
+    return order;
+}
+
+inline Vector3D triangleNormal(const std::vector<Vertex>& vertices, const unsigned int* tri)
+{
+    /* not normalized, the length is twice the area */
+    return cross(vertices[tri[1]].pos - vertices[tri[0]].pos, vertices[tri[2]].pos - vertices[tri[0]].pos);
+}
+
+constexpr unsigned int unusedVertex = ~0u;
+
+/* optimize one material range in place. remap has one entry per vertex of the model that is unusedVertex, it maps the
+   vertices of the range to 0 .. n - 1 so Tipsify only needs arrays of the size of the range, and is reset before
+   returning. */
+void optimizeRange(ModelData& model, unsigned int first, unsigned int count, unsigned int cacheSize, std::vector<unsigned int>& remap)
+{
+    std::size_t triangleCount = count / 3;
+    if(triangleCount < 2)
+    {
+        return;
+    }
+
+    const unsigned int* indices = model.indices.data() + first;
+
+    std::vector<unsigned int> local(triangleCount * 3);
+    std::vector<unsigned int> used;
+    for(std::size_t i = 0; i < local.size(); i++)
+    {
+        unsigned int& index = remap[indices[i]];
+        if(index == unusedVertex)
+        {
+            index = static_cast<unsigned int>(used.size());
+            used.push_back(indices[i]);
+        }
+        local[i] = index;
+    }
+    for(unsigned int v : used)
+    {
+        remap[v] = unusedVertex;
+    }
+
+    std::vector<std::size_t> clusters;
+    std::vector<unsigned int> order = tipsify(local.data(), triangleCount, used.size(), cacheSize, clusters);
+    clusters.push_back(order.size());
+
+    /* centroid of the whole range, weighted by triangle area */
+    Vector3D center;
+    float area = 0.0f;
+    for(std::size_t t = 0; t < triangleCount; t++)
+    {
+        const unsigned int* tri = indices + 3 * t;
+        float a = length(triangleNormal(model.vertices, tri));
+        center += a * (model.vertices[tri[0]].pos + model.vertices[tri[1]].pos + model.vertices[tri[2]].pos) / 3.0f;
+        area += a;
+    }
+    center = area > 0.0f ? center / area : center;
+
+    /* clusters facing away from the center are likely in front of the others, draw them first */
+    struct Cluster { std::size_t begin, end; float sortKey; };
+    std::vector<Cluster> sorted;
+    for(std::size_t c = 0; c + 1 < clusters.size(); c++)
+    {
+        Vector3D clusterCenter, normal;
+        float clusterArea = 0.0f;
+        for(std::size_t i = clusters[c]; i < clusters[c + 1]; i++)
+        {
+            const unsigned int* tri = indices + 3 * order[i];
+            Vector3D n = triangleNormal(model.vertices, tri);
+            float a = length(n);
+            clusterCenter += a * (model.vertices[tri[0]].pos + model.vertices[tri[1]].pos + model.vertices[tri[2]].pos) / 3.0f;
+            clusterArea += a;
+            normal += n;
+        }
+
+        float sortKey = 0.0f;
+        if(clusterArea > 0.0f && length(normal) > 0.0f)
+        {
+            sortKey = dot(clusterCenter / clusterArea - center, normalize(normal));
+        }
+        sorted.push_back({clusters[c], clusters[c + 1], sortKey});
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> result;
+    result.reserve(count);
+    for(const auto& cluster : sorted)
+    {
+        for(std::size_t i = cluster.begin; i < cluster.end; i++)
+        {
+            result.insert(result.end(), indices + 3 * order[i], indices + 3 * order[i] + 3);
+        }
+    }
+
+    std::copy(result.begin(), result.end(), model.indices.begin() + first);
+}
+
+/* renumber vertices in order of first use, unused vertices are kept at the end */
+void optimizeVertexFetch(ModelData& model)
+{
+    const unsigned int unused = unusedVertex;
+    std::vector<unsigned int> remap(model.vertices.size(), unused);
+    std::vector<Vertex> vertices;
+    vertices.reserve(model.vertices.size());
+
+    for(auto& index : model.indices)
+    {
+        if(remap[index] == unused)
+        {
+            remap[index] = static_cast<unsigned int>(vertices.size());
+            vertices.push_back(model.vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    for(std::size_t v = 0; v < model.vertices.size(); v++)
+    {
+        if(remap[v] == unused)
+        {
+            vertices.push_back(model.vertices[v]);
+        }
+    }
+
+    model.vertices = std::move(vertices);
+}
+
+}
+
+float meshACMR(const std::vector<unsigned int> &indices, unsigned int cacheSize)
+{
+    if(indices.size() < 3)
+    {
+        return 0.0f;
+    }
+
+    std::deque<unsigned int> cache;
+    std::size_t misses = 0;
+
+    for(unsigned int index : indices)
+    {
+        if(std::find(cache.begin(), cache.end(), index) != cache.end())
+        {
+            continue;
+        }
+
+        misses++;
+        cache.push_back(index);
+        if(cache.size() > cacheSize)
+        {
+            cache.pop_front();
+        }
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+MeshOptimizeStats meshOptimize(ModelData &model, unsigned int cacheSize)
+{
+    MeshOptimizeStats stats;
+    stats.acmrBefore = meshACMR(model.indices, cacheSize);
+
+    /* shared by all ranges, allocated once */
+    std::vector<unsigned int> remap(model.vertices.size(), detail::unusedVertex);
+
+    for(const auto& material : model.material)
+    {
+        detail::optimizeRange(model, material.indexOffset, material.indexCount, cacheSize, remap);
+    }
+    for(const auto& lod : model.lod)
+    {
+        for(const auto& material : lod.material)
+        {
+            detail::optimizeRange(model, material.indexOffset, material.indexCount, cacheSize, remap);
+        }
+    }
+
+    /* models without materials are drawn as one range */
+    if(model.material.empty())
+    {
+        detail::optimizeRange(model, 0, static_cast<unsigned int>(model.indices.size()), cacheSize, remap);
+    }
+
+    detail::optimizeVertexFetch(model);
+
+    stats.acmrAfter = meshACMR(model.indices, cacheSize);
+    return stats;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "model.h"
+
+#include <vector>
+
+struct MeshOptimizeStats
+{
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+};
+
+/**
+ * @brief Average cache miss ratio (vertex shader invocations per triangle) of a triangle list, simulated with a FIFO
+ * post-transform cache.
+ *
+ * @param indices Triangle list.
+ * @param cacheSize Number of entries of the simulated cache.
+ *
+ * @return Cache misses per triangle (0.5 is the optimum for large regular grids, 3 the worst case).
+ */
+float meshACMR(const std::vector<unsigned int>& indices, unsigned int cacheSize = 16);
+
+/**
+ * @brief Reorder the triangles of each material range (including those of the levels) for post-transform cache
+ * locality (Tipsify), then reorder clusters of them to draw outward facing parts first (less overdraw), and finally
+ * reorder the vertex buffer in order of first use. Triangles keep their vertex order and stay in their material range,
+ * so the rendered result does not change.
+ *
+ * @param model Model data to optimize in place.
+ * @param cacheSize Post-transform cache size to optimize for.
+ *
+ * @return ACMR of the index buffer before and after the optimization.
+ */
+MeshOptimizeStats meshOptimize(ModelData& model, unsigned int cacheSize = 16);
@@ -0,0 +1,312 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace detail
+{
+
+using Clock = std::chrono::steady_clock;
+
+/* the GPU clock is mapped to the CPU clock again after this many nanoseconds, it may drift */
+constexpr std::int64_t calibrationInterval = 1000000000;
+
+/* thread 0 is the GPU track of the trace */
+struct Event
+{
+    const char* name;
+    std::uint32_t thread;
+    std::int64_t begin;
+    std::int64_t end;
+};
+
+struct Zone
+{
+    std::array<double, profileWindow> durations;
+    unsigned int count = 0;
+    unsigned int next = 0;
+};
+
+struct PendingGpuZone
+{
+    const char* name;
+    std::string path;
+    GLuint queries[2];
+};
+
+struct Profiler
+{
+    std::mutex mutex;
+    Clock::time_point start = Clock::now();
+    std::uint32_t threads = 0;
+    /* thread that calls profilerNewFrame */
+    std::uint32_t mainThread = 0;
+
+    std::deque<Event> events;
+    /* CPU zones (false) before GPU zones (true), both sorted by path */
+    std::map<std::pair<bool, std::string>, Zone> zones;
+
+    /* OpenGL thread only */
+    std::vector<GLuint> queries;
+    std::vector<PendingGpuZone> pending;
+    std::int64_t gpuOffset = 0;
+    std::int64_t calibrated = -calibrationInterval;
+};
+
+Profiler profiler;
+
+/* zones the calling thread is in, as path, the GPU zones have their own */
+thread_local std::string cpuPath;
+thread_local std::string gpuPath;
+
+std::int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - profiler.start).count();
+}
+
+std::uint32_t threadIndex()
+{
+    thread_local std::uint32_t index = 0;
+    if(index == 0)
+    {
+        std::lock_guard<std::mutex> lock(profiler.mutex);
+        index = ++profiler.threads;
+    }
+    return index;
+}
+
+std::size_t push(std::string& path, const char* name)
+{
+    std::size_t parent = path.size();
+    if(parent > 0)
+    {
+        path += '/';
+    }
+    path += name;
+    return parent;
+}
+
+void record(const char* name, const std::string& path, bool gpu, std::uint32_t thread, std::int64_t begin, std::int64_t end)
+{
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+
+    profiler.events.push_back(Event{name, thread, begin, end});
+    if(profiler.events.size() > profileTraceEvents)
+    {
+        profiler.events.pop_front();
+    }
+
+    Zone& zone = profiler.zones[{gpu, path}];
+    zone.durations[zone.next] = double(end - begin) * 1e-6;
+    zone.next = (zone.next + 1) % profileWindow;
+    zone.count = std::min(zone.count + 1, profileWindow);
+}
+
+/* timestamp queries are core since GL 3.3, some core contexts (e.g. macOS) don't list the extension (see glLoadCore33) */
+bool timerQueries()
+{
+    return glVersionAtLeast(3, 3) || GLAD_GL_ARB_timer_query;
+}
+
+GLuint query()
+{
+    if(profiler.queries.empty())
+    {
+        GLuint queries[16];
+        glGenQueries(16, queries);
+        profiler.queries.insert(profiler.queries.end(), queries, queries + 16);
+    }
+
+    GLuint query = profiler.queries.back();
+    profiler.queries.pop_back();
+    return query;
+}
+
+void writeString(std::ostream& out, const char* text)
+{
+    out << '"';
+    for(const char* c = text; *c != '\0'; c++)
+    {
+        if(*c == '"' || *c == '\\')
+        {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+}
+
+ProfileZone::ProfileZone(const char *name)
+    : name(name), begin(detail::now()), parent(detail::push(detail::cpuPath, name))
+{
+}
+
+ProfileZone::~ProfileZone()
+{
+    detail::record(name, detail::cpuPath, false, detail::threadIndex(), begin, detail::now());
+    detail::cpuPath.resize(parent);
+}
+
+ProfileGpuZone::ProfileGpuZone(const char *name)
+    : name(name), parent(detail::push(detail::gpuPath, name))
+{
+    if(detail::timerQueries())
+    {
+        queries[0] = detail::query();
+        queries[1] = detail::query();
+        glQueryCounter(queries[0], GL_TIMESTAMP);
+    }
+}
+
+ProfileGpuZone::~ProfileGpuZone()
+{
+    if(queries[0] != 0)
+    {
+        glQueryCounter(queries[1], GL_TIMESTAMP);
+        detail::profiler.pending.push_back(detail::PendingGpuZone{name, detail::gpuPath, {queries[0], queries[1]}});
+    }
+    detail::gpuPath.resize(parent);
+}
+
+void profilerNewFrame()
+{
+    auto& profiler = detail::profiler;
+    std::uint32_t thread = detail::threadIndex();
+    {
+        std::lock_guard<std::mutex> lock(profiler.mutex);
+        profiler.mainThread = thread;
+    }
+    if(!detail::timerQueries())
+    {
+        return;
+    }
+
+    std::int64_t cpuTime = detail::now();
+    if(cpuTime - profiler.calibrated >= detail::calibrationInterval)
+    {
+        GLint64 gpuTime = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+        profiler.gpuOffset = cpuTime - gpuTime;
+        profiler.calibrated = cpuTime;
+    }
+
+    /* zones finish in the order they were issued, the first one that isn't available ends the search */
+    std::size_t done = 0;
+    for(; done < profiler.pending.size(); done++)
+    {
+        const auto& zone = profiler.pending[done];
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(zone.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+        {
+            break;
+        }
+
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(zone.queries[0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(zone.queries[1], GL_QUERY_RESULT, &end);
+        detail::record(zone.name, zone.path, true, 0, std::int64_t(begin) + profiler.gpuOffset, std::int64_t(end) + profiler.gpuOffset);
+        profiler.queries.insert(profiler.queries.end(), zone.queries, zone.queries + 2);
+    }
+    profiler.pending.erase(profiler.pending.begin(), profiler.pending.begin() + done);
+}
+
+std::vector<ProfileStats> profilerStats()
+{
+    std::lock_guard<std::mutex> lock(detail::profiler.mutex);
+
+    std::vector<ProfileStats> stats;
+    for(const auto& [key, zone] : detail::profiler.zones)
+    {
+        ProfileStats entry;
+        entry.gpu = key.first;
+        entry.path = key.second;
+        entry.samples = zone.count;
+        entry.last = zone.durations[(zone.next + profileWindow - 1) % profileWindow];
+
+        auto first = zone.durations.begin();
+        auto last = first + zone.count;
+        entry.min = *std::min_element(first, last);
+        entry.max = *std::max_element(first, last);
+        for(auto it = first; it != last; ++it)
+        {
+            entry.mean += *it;
+        }
+        entry.mean /= double(zone.count);
+
+        stats.push_back(entry);
+    }
+
+    return stats;
+}
+
+bool profilerWriteTrace(const std::string &filepath)
+{
+    std::vector<detail::Event> events;
+    std::uint32_t threads = 0;
+    std::uint32_t mainThread = 0;
+    {
+        std::lock_guard<std::mutex> lock(detail::profiler.mutex);
+        events.assign(detail::profiler.events.begin(), detail::profiler.events.end());
+        threads = detail::profiler.threads;
+        mainThread = detail::profiler.mainThread;
+    }
+
+    std::ofstream file(filepath);
+    if(!file.is_open())
+    {
+        std::cerr << "[Profiler] Couldn't open " << filepath << std::endl;
+        return false;
+    }
+
+    /* complete events (ph X) with times in microseconds, one track per thread */
+    file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+    file << R"({"name":"thread_name","ph":"M","pid":1,"tid":0,"args":{"name":"GPU"}})";
+    for(std::uint32_t thread = 1; thread <= threads; thread++)
+    {
+        file << ",\n" << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << thread << R"(,"args":{"name":")";
+        if(thread == mainThread)
+        {
+            file << "main\"}}";
+        }
+        else
+        {
+            file << "thread " << thread << "\"}}";
+        }
+    }
+    for(const auto& event : events)
+    {
+        file << ",\n{\"name\":";
+        detail::writeString(file, event.name);
+        file << ",\"cat\":\"" << (event.thread == 0 ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+             << ",\"ts\":" << double(event.begin) * 1e-3 << ",\"dur\":" << double(event.end - event.begin) * 1e-3 << "}";
+    }
+    file << "\n]}\n";
+
+    return file.good();
+}
+
+void profilerDelete()
+{
+    auto& profiler = detail::profiler;
+    for(const auto& zone : profiler.pending)
+    {
+        profiler.queries.insert(profiler.queries.end(), zone.queries, zone.queries + 2);
+    }
+    profiler.pending.clear();
+
+    if(!profiler.queries.empty())
+    {
+        glDeleteQueries(static_cast<GLsizei>(profiler.queries.size()), profiler.queries.data());
+        profiler.queries.clear();
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "base.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* number of durations per zone the statistics are computed from, and events kept for the trace */
+constexpr unsigned int profileWindow = 120;
+constexpr std::size_t profileTraceEvents = 1 << 16;
+
+/* statistics of a zone over its last profileWindow occurrences, in milliseconds */
+struct ProfileStats
+{
+    /* names of the enclosing zones and the zone, separated by / */
+    std::string path;
+    bool gpu = false;
+
+    unsigned int samples = 0;
+    double last = 0.0;
+    double mean = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+/* CPU zone from construction to destruction on the calling thread, see PROFILE_ZONE */
+struct ProfileZone
+{
+    explicit ProfileZone(const char* name);
+    ~ProfileZone();
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+    const char* name;
+    std::int64_t begin;
+    std::size_t parent;
+};
+
+/* GPU zone: timestamps of the commands issued between construction and destruction, see PROFILE_GPU_ZONE. Only on the
+   OpenGL thread, the results are collected by profilerNewFrame once the GPU got there. */
+struct ProfileGpuZone
+{
+    explicit ProfileGpuZone(const char* name);
+    ~ProfileGpuZone();
+    ProfileGpuZone(const ProfileGpuZone&) = delete;
+    ProfileGpuZone& operator=(const ProfileGpuZone&) = delete;
+
+    const char* name;
+    GLuint queries[2] = {0, 0};
+    std::size_t parent;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+/* time the rest of the enclosing scope, name has to be a string literal (it is referenced, not copied) */
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) ProfileGpuZone PROFILE_CONCAT(profileGpuZone, __LINE__)(name)
+
+/**
+ * @brief Collect the GPU zones whose results are available, without waiting for the others. Has to be called once
+ * per frame on the OpenGL thread.
+ */
+void profilerNewFrame();
+
+/**
+ * @brief Statistics of all zones seen so far.
+ *
+ * @return Statistics of the CPU zones, then of the GPU zones, both sorted by path (nested zones follow their parent).
+ */
+std::vector<ProfileStats> profilerStats();
+
+/**
+ * @brief Write the last profileTraceEvents events as Chrome trace (JSON, open in chrome://tracing or Perfetto). GPU zones
+ * are on their own track.
+ *
+ * @param filepath Path to output file.
+ *
+ * @return True if the file was written.
+ */
+bool profilerWriteTrace(const std::string& filepath);
+
+/**
+ * @brief Delete the queries of the GPU zones, has to be called before the OpenGL context is destroyed.
+ */
+void profilerDelete();
@@ -0,0 +1,178 @@
+#include "recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+namespace detail
+{
+
+bool hasExtension(const std::string& path, const std::string& extension)
+{
+    return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+/* BT.601 limited range, chroma is the average of 2x2 pixels (the last row and column are repeated for odd sizes) */
+std::vector<unsigned char> yuv420(const CaptureJob& job)
+{
+    std::size_t width = job.width;
+    std::size_t height = job.height;
+    std::size_t chromaWidth = (width + 1) / 2;
+    std::size_t chromaHeight = (height + 1) / 2;
+
+    std::vector<unsigned char> planes(width * height + 2 * chromaWidth * chromaHeight);
+    unsigned char* yPlane = planes.data();
+    unsigned char* uPlane = yPlane + width * height;
+    unsigned char* vPlane = uPlane + chromaWidth * chromaHeight;
+
+    /* the rows of the job are bottom to top */
+    auto pixel = [&](std::size_t x, std::size_t y) { return job.pixels.data() + 4 * ((height - 1 - y) * width + x); };
+
+    for(std::size_t y = 0; y < height; y++)
+    {
+        for(std::size_t x = 0; x < width; x++)
+        {
+            const unsigned char* p = pixel(x, y);
+            yPlane[y * width + x] = static_cast<unsigned char>(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+        }
+    }
+
+    for(std::size_t y = 0; y < chromaHeight; y++)
+    {
+        for(std::size_t x = 0; x < chromaWidth; x++)
+        {
+            int r = 0, g = 0, b = 0;
+            for(std::size_t i = 0; i < 4; i++)
+            {
+                const unsigned char* p = pixel(std::min(2 * x + (i & 1), width - 1), std::min(2 * y + (i >> 1), height - 1));
+                r += p[0];
+                g += p[1];
+                b += p[2];
+            }
+            uPlane[y * chromaWidth + x] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+            vPlane[y * chromaWidth + x] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+        }
+    }
+
+    return planes;
+}
+
+/* convert on the calling encoder thread, then wait for the turn of the frame to append it */
+void writeStream(RecordStream& stream, std::uint64_t frame, const CaptureJob& job)
+{
+    std::vector<unsigned char> planes;
+    if(!job.pixels.empty())
+    {
+        planes = yuv420(job);
+    }
+
+    std::unique_lock<std::mutex> lock(stream.mutex);
+    stream.turn.wait(lock, [&]() { return stream.next == frame; });
+
+    /* a frame that couldn't be read is left out, the following frames still have to get their turn */
+    if(!planes.empty())
+    {
+        stream.file << "FRAME\n";
+        stream.file.write(reinterpret_cast<const char*>(planes.data()), static_cast<std::streamsize>(planes.size()));
+    }
+    bool written = !planes.empty() && stream.file.good();
+
+    stream.next++;
+    lock.unlock();
+    stream.turn.notify_all();
+
+    if(!written)
+    {
+        throw std::runtime_error(planes.empty() ? "couldn't map pixel buffer" : "couldn't write stream");
+    }
+}
+
+}
+
+eRecordFormat recordFormat(const std::string &path)
+{
+    if(detail::hasExtension(path, ".y4m"))
+    {
+        return RecordY4M;
+    }
+    return detail::hasExtension(path, ".qoi") ? RecordQOI : RecordPNG;
+}
+
+Recorder recorderCreate(const std::string &path, unsigned int width, unsigned int height, float fps, unsigned int encoderThreads)
+{
+    Recorder recorder;
+    recorder.format = recordFormat(path);
+    recorder.path = path;
+    recorder.width = width;
+    recorder.height = height;
+
+    std::filesystem::path file(path);
+    if(file.has_parent_path())
+    {
+        std::filesystem::create_directories(file.parent_path());
+    }
+
+    std::filesystem::path timestamps = recorder.format == RecordY4M ? std::filesystem::path(file).replace_extension(".txt")
+                                                                    : file.parent_path() / "timestamps.txt";
+    recorder.timestamps.open(timestamps);
+    if(!recorder.timestamps.is_open())
+    {
+        throw std::runtime_error("[Recorder] Couldn't open " + timestamps.string());
+    }
+    recorder.timestamps << "# frame time" << std::endl;
+
+    if(recorder.format == RecordY4M)
+    {
+        recorder.stream = std::make_shared<RecordStream>();
+        recorder.stream->file.open(path, std::ios::binary);
+        if(!recorder.stream->file.is_open())
+        {
+            throw std::runtime_error("[Recorder] Couldn't open " + path);
+        }
+
+        /* the frame rate as a fraction with millisecond precision */
+        auto rate = static_cast<long>(std::lround(std::max(fps, 0.001f) * 1000.0f));
+        long divisor = std::gcd(rate, 1000L);
+        recorder.stream->file << "YUV4MPEG2 W" << width << " H" << height << " F" << rate / divisor << ":" << 1000 / divisor
+                              << " Ip A1:1 C420jpeg\n";
+    }
+
+    /* a few frames per encoder may queue up before the render thread waits for them */
+    unsigned int threads = encoderThreads > 0 ? encoderThreads : std::max(std::thread::hardware_concurrency(), 1u);
+    recorder.capture = captureCreate(3, threads, 2 * threads);
+
+    return recorder;
+}
+
+void recorderDelete(Recorder &recorder)
+{
+    captureDelete(recorder.capture);
+    recorder = Recorder{};
+}
+
+void recorderFrame(Recorder &recorder, GLuint framebuffer, GLenum readBuffer, double time)
+{
+    std::uint64_t frame = recorder.frames++;
+    recorder.timestamps << frame << " " << time << "\n";
+
+    if(recorder.format == RecordY4M)
+    {
+        std::shared_ptr<RecordStream> stream = recorder.stream;
+        captureRead(recorder.capture, framebuffer, readBuffer, recorder.width, recorder.height,
+                    [stream, frame](CaptureJob& job) { detail::writeStream(*stream, frame, job); });
+        return;
+    }
+
+    std::vector<char> filepath(recorder.path.size() + 32);
+    std::snprintf(filepath.data(), filepath.size(), recorder.path.c_str(), static_cast<int>(frame));
+    captureRead(recorder.capture, framebuffer, readBuffer, recorder.width, recorder.height, filepath.data());
+}
+
+bool recorderUpdate(Recorder &recorder)
+{
+    return captureUpdate(recorder.capture);
+}
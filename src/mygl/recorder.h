@@ -0,0 +1,91 @@
+#pragma once
+
+#include "capture.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+enum eRecordFormat { RecordPNG = 0, RecordQOI = 1, RecordY4M = 2 };
+
+/* raw video file the frames are appended to, frames are converted in parallel and written in the order they were
+   recorded */
+struct RecordStream
+{
+    std::ofstream file;
+    std::mutex mutex;
+    std::condition_variable turn;
+    std::uint64_t next = 0;
+};
+
+/* records every frame through a capture: numbered PNG or QOI images or one Y4M stream (YUV 4:2:0), plus a text file with
+   the time of every frame (the main loop doesn't run at a fixed rate) */
+struct Recorder
+{
+    eRecordFormat format = RecordPNG;
+    /* printf pattern for the frame number (PNG, QOI) or path of the stream (Y4M) */
+    std::string path;
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    std::uint64_t frames = 0;
+    Capture capture;
+
+    /* frame number and time of every frame, one line per frame */
+    std::ofstream timestamps;
+    std::shared_ptr<RecordStream> stream;
+};
+
+/**
+ * @brief Format of a recording from its path: .y4m is a stream, .qoi a QOI and everything else a PNG image sequence.
+ *
+ * @param path Path of the recording.
+ *
+ * @return Record format.
+ */
+eRecordFormat recordFormat(const std::string& path);
+
+/**
+ * @brief Start a recording. The directory of the path is created if it doesn't exist, the timestamps are written to
+ * timestamps.txt next to an image sequence and to the path with the extension .txt for a stream.
+ *
+ * @param path Printf pattern for the frame number as int (e.g. recording/frame%06d.png) or stream file (e.g.
+ * recording.y4m).
+ * @param width Width of the frames.
+ * @param height Height of the frames.
+ * @param fps Nominal frame rate written to the header of a stream.
+ * @param encoderThreads Number of encoder threads (0 uses the number of hardware threads).
+ *
+ * @return Recorder, has to be deleted with recorderDelete.
+ */
+Recorder recorderCreate(const std::string& path, unsigned int width, unsigned int height, float fps = 60.0f, unsigned int encoderThreads = 0);
+
+/**
+ * @brief Wait until all frames are written and close the recording.
+ *
+ * @param recorder Recorder to delete.
+ */
+void recorderDelete(Recorder& recorder);
+
+/**
+ * @brief Record the current frame (width x height pixels from 0, 0). When the encoders fall behind, this waits for them
+ * (counted in capture.stalls) instead of dropping frames.
+ *
+ * @param recorder Recorder.
+ * @param framebuffer Framebuffer object to read (0 for the default framebuffer).
+ * @param readBuffer Color buffer to read, e.g. GL_BACK or GL_COLOR_ATTACHMENT0.
+ * @param time Time of the frame in seconds, written to the timestamps.
+ */
+void recorderFrame(Recorder& recorder, GLuint framebuffer, GLenum readBuffer, double time);
+
+/**
+ * @brief Hand finished reads to the encoders. Has to be called once per frame on the OpenGL thread.
+ *
+ * @param recorder Recorder.
+ *
+ * @return True if all recorded frames are written.
+ */
+bool recorderUpdate(Recorder& recorder);
@@ -0,0 +1,244 @@
+#include "renderqueue.h"
+
+#include "glstate.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace detail
+{
+
+constexpr unsigned int layerBits = 4;
+constexpr unsigned int programBits = 12;
+constexpr unsigned int materialBits = 16;
+constexpr unsigned int vaoBits = 12;
+constexpr unsigned int depthBits = 20;
+
+std::uint64_t field(std::uint64_t value, unsigned int bits)
+{
+    return std::min<std::uint64_t>(value, (std::uint64_t(1) << bits) - 1);
+}
+
+/* key and world bounds are filled in here */
+void push(RenderQueue& queue, RenderItem item, const Bounds& world)
+{
+    if(item.material->indexCount == 0)
+    {
+        return;
+    }
+
+    auto materialId = queue.materialIds.emplace(item.material, static_cast<unsigned int>(queue.materialIds.size())).first->second;
+
+    /* distance of the bounds center, quantized over [0, far plane] */
+    float depth = std::clamp(length(world.center - queue.cameraPosition) / queue.farPlane, 0.0f, 1.0f);
+
+    std::uint64_t key = field(item.layer, layerBits);
+    key = (key << programBits) | field(item.program->id, programBits);
+    key = (key << materialBits) | field(materialId, materialBits);
+    key = (key << vaoBits) | field(item.mesh->vao, vaoBits);
+    key = (key << depthBits) | static_cast<std::uint64_t>(depth * float((1u << depthBits) - 1));
+
+    item.key = key;
+    item.bounds = world;
+    queue.items.push_back(item);
+}
+
+void cull(RenderQueue& queue)
+{
+    std::size_t count = queue.items.size();
+    queue.sphereX.resize(count);
+    queue.sphereY.resize(count);
+    queue.sphereZ.resize(count);
+    queue.sphereRadius.resize(count);
+    queue.visible.resize(count);
+    for(std::size_t i = 0; i < count; i++)
+    {
+        const Bounds& bounds = queue.items[i].bounds;
+        queue.sphereX[i] = bounds.center.x;
+        queue.sphereY[i] = bounds.center.y;
+        queue.sphereZ[i] = bounds.center.z;
+        queue.sphereRadius[i] = bounds.radius;
+    }
+
+    frustumCullSpheres(queue.frustum, queue.sphereX.data(), queue.sphereY.data(), queue.sphereZ.data(), queue.sphereRadius.data(), count, queue.visible.data());
+
+    /* spheres are loose for long thin parts, the box test removes some more */
+    std::size_t visibleCount = 0;
+    for(std::size_t i = 0; i < count; i++)
+    {
+        if(queue.visible[i] && frustumTestBox(queue.frustum, queue.items[i].bounds))
+        {
+            queue.items[visibleCount++] = queue.items[i];
+        }
+    }
+    queue.items.resize(visibleCount);
+    queue.drawn = visibleCount;
+    queue.culled = count - visibleCount;
+}
+
+/* one batch per run of sorted items with the same programs and instance buffer (or primitive mode) */
+void buildBatches(RenderQueue& queue)
+{
+    queue.batchCount = 0;
+    for(std::size_t first = 0; first < queue.items.size();)
+    {
+        const RenderItem& head = queue.items[first];
+        if(queue.batchCount == queue.batches.size())
+        {
+            queue.batches.emplace_back().batch = drawBatchCreate();
+        }
+
+        RenderBatch& batch = queue.batches[queue.batchCount++];
+        batch.program = head.program;
+        batch.depthProgram = head.depthProgram;
+        batch.instances = head.instances;
+        batch.arrays = head.arrays;
+        batch.mode = head.mode;
+        drawBatchClear(batch.batch);
+
+        std::size_t last = first;
+        for(; last < queue.items.size(); last++)
+        {
+            const RenderItem& item = queue.items[last];
+            if(item.program != batch.program || item.depthProgram != batch.depthProgram || item.instances != batch.instances ||
+               item.arrays != batch.arrays || item.mode != batch.mode)
+            {
+                break;
+            }
+
+            if(item.instances || item.arrays)
+            {
+                drawBatchAddInstanced(batch.batch, *item.mesh, *item.material, item.transform, item.firstInstance, item.instanceCount);
+            }
+            else
+            {
+                drawBatchAdd(batch.batch, *item.mesh, *item.material, item.transform);
+            }
+        }
+        first = last;
+    }
+}
+
+}
+
+RenderQueue renderQueueCreate()
+{
+    /* draw batches are created on demand by the first frames */
+    return RenderQueue{};
+}
+
+void renderQueueDelete(RenderQueue &queue)
+{
+    for(auto& batch : queue.batches)
+    {
+        drawBatchDelete(batch.batch);
+    }
+    queue.batches.clear();
+    queue.batchCount = 0;
+    queue.items.clear();
+    queue.materialIds.clear();
+}
+
+void renderQueueBegin(RenderQueue &queue, const Camera &camera)
+{
+    queue.items.clear();
+    queue.materialIds.clear();
+    queue.sorted = false;
+    queue.batchCount = 0;
+    queue.drawn = 0;
+    queue.culled = 0;
+    queue.cameraPosition = camera.position;
+    queue.farPlane = camera.farPlane;
+    queue.frustum = frustumExtract(cameraProjection(camera) * cameraView(camera));
+}
+
+void renderQueuePush(RenderQueue &queue, ShaderProgram &program, const Mesh &mesh, const Material &material, const Matrix4D &transform, const Bounds &bounds, ShaderProgram *depthProgram, unsigned int layer)
+{
+    RenderItem item;
+    item.program = &program;
+    item.depthProgram = depthProgram;
+    item.layer = layer;
+    item.mesh = &mesh;
+    item.material = &material;
+    item.transform = transform;
+    detail::push(queue, item, boundsTransform(bounds, transform));
+}
+
+void renderQueuePushInstanced(RenderQueue &queue, ShaderProgram &program, const Mesh &mesh, const Material &material, const Matrix4D &transform, InstanceBuffer &instances, unsigned int firstInstance, unsigned int instanceCount, const Bounds &bounds, ShaderProgram *depthProgram, unsigned int layer)
+{
+    if(instanceCount == 0)
+    {
+        return;
+    }
+
+    RenderItem item;
+    item.program = &program;
+    item.depthProgram = depthProgram;
+    item.layer = layer;
+    item.mesh = &mesh;
+    item.material = &material;
+    item.transform = transform;
+    item.instances = &instances;
+    item.firstInstance = firstInstance;
+    item.instanceCount = instanceCount;
+    detail::push(queue, item, bounds);
+}
+
+void renderQueuePushArrays(RenderQueue &queue, ShaderProgram &program, const Mesh &mesh, const Material &material, GLenum mode, unsigned int instanceCount, const Bounds &bounds, ShaderProgram *depthProgram, unsigned int layer)
+{
+    if(instanceCount == 0)
+    {
+        return;
+    }
+
+    RenderItem item;
+    item.program = &program;
+    item.depthProgram = depthProgram;
+    item.layer = layer;
+    item.mesh = &mesh;
+    item.material = &material;
+    item.transform = Matrix4D::identity();
+    item.instanceCount = instanceCount;
+    item.arrays = true;
+    item.mode = mode;
+    detail::push(queue, item, bounds);
+}
+
+void renderQueueSubmit(RenderQueue &queue, bool depthOnly)
+{
+    PROFILE_ZONE("renderQueueSubmit");
+    PROFILE_GPU_ZONE("renderQueueSubmit");
+
+    if(!queue.sorted)
+    {
+        detail::cull(queue);
+        std::sort(queue.items.begin(), queue.items.end(), [](const RenderItem& a, const RenderItem& b) { return a.key < b.key; });
+        detail::buildBatches(queue);
+        queue.sorted = true;
+    }
+
+    for(std::size_t i = 0; i < queue.batchCount; i++)
+    {
+        RenderBatch& batch = queue.batches[i];
+        ShaderProgram* program = depthOnly ? batch.depthProgram : batch.program;
+        if(!program)
+        {
+            continue;
+        }
+
+        stateUseProgram(program->id);
+        if(batch.arrays)
+        {
+            drawBatchSubmitArrays(batch.batch, *program, batch.mode);
+        }
+        else if(batch.instances)
+        {
+            drawBatchSubmitInstanced(batch.batch, *program, *batch.instances, depthOnly);
+        }
+        else
+        {
+            drawBatchSubmit(batch.batch, *program, depthOnly);
+        }
+    }
+}
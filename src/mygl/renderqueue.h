@@ -0,0 +1,161 @@
+#pragma once
+
+#include "batch.h"
+#include "camera.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/* one material range of a mesh, drawn with a program and a model matrix */
+struct RenderItem
+{
+    /* layer (4 bits) | program (12 bits) | material (16 bits) | VAO (12 bits) | depth (20 bits), see renderQueuePush */
+    std::uint64_t key = 0;
+
+    /* items of lower layers are drawn first, e.g. occluders before the surfaces they cover */
+    unsigned int layer = 0;
+
+    ShaderProgram* program = nullptr;
+    /* program of depth-only submits, items without one are not drawn there */
+    ShaderProgram* depthProgram = nullptr;
+    const Mesh* mesh = nullptr;
+    const Material* material = nullptr;
+    Matrix4D transform;
+
+    /* range of an instance buffer the item is drawn for, instances is null for items drawn once */
+    InstanceBuffer* instances = nullptr;
+    unsigned int firstInstance = 0;
+    unsigned int instanceCount = 0;
+
+    /* geometry generated in the vertex shader (see Clipmap in grid.h) is drawn with glDrawArraysInstanced in this
+       primitive mode */
+    bool arrays = false;
+    GLenum mode = GL_TRIANGLES;
+
+    /* world space bounds used for culling */
+    Bounds bounds;
+};
+
+/* sorted items with the same programs and instance buffer (or primitive mode), submitted as one draw batch */
+struct RenderBatch
+{
+    ShaderProgram* program = nullptr;
+    ShaderProgram* depthProgram = nullptr;
+    InstanceBuffer* instances = nullptr;
+    bool arrays = false;
+    GLenum mode = GL_TRIANGLES;
+    DrawBatch batch;
+};
+
+struct RenderQueue
+{
+    std::vector<RenderItem> items;
+
+    /* materials are numbered in the order they are pushed, the numbers are only valid for one frame */
+    std::unordered_map<const Material*, unsigned int> materialIds;
+
+    /* camera of the frame, used for culling and the depth part of the key */
+    Vector3D cameraPosition;
+    float farPlane = 1.0f;
+    Frustum frustum;
+
+    /* sphere centers and radii of all items in structure of arrays layout for frustumCullSpheres */
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    std::vector<std::uint8_t> visible;
+
+    /* items drawn and culled in the current frame */
+    std::size_t drawn = 0;
+    std::size_t culled = 0;
+
+    /* the items are culled, sorted and batched by the first renderQueueSubmit of a frame, later submits (e.g. the
+       shading pass after a depth pre-pass) draw the same batches. Batches are kept over frames, batchCount are used. */
+    bool sorted = false;
+    std::vector<RenderBatch> batches;
+    std::size_t batchCount = 0;
+};
+
+/**
+ * @brief Create an empty render queue.
+ *
+ * @return Render queue.
+ */
+RenderQueue renderQueueCreate();
+
+/**
+ * @brief Delete the draw batches of a render queue.
+ *
+ * @param queue Render queue to delete.
+ */
+void renderQueueDelete(RenderQueue& queue);
+
+/**
+ * @brief Start a new frame: remove all items and remember the camera (and its frustum) for culling and depth sorting.
+ *
+ * @param queue Render queue.
+ * @param camera Camera of the frame.
+ */
+void renderQueueBegin(RenderQueue& queue, const Camera& camera);
+
+/**
+ * @brief Add the index range of a material to the queue. Mesh and material are referenced until the last
+ * renderQueueSubmit of the frame.
+ *
+ * @param queue Render queue.
+ * @param program Shader program the item is drawn with.
+ * @param mesh Mesh the material belongs to.
+ * @param material Material with index range.
+ * @param transform Model matrix.
+ * @param bounds Object space bounds of the item, transformed with the model matrix for culling.
+ * @param depthProgram Shader program of depth-only submits, nullptr to leave the item out of them.
+ * @param layer Items are sorted by layer before anything else (0 .. 15).
+ */
+void renderQueuePush(RenderQueue& queue, ShaderProgram& program, const Mesh& mesh, const Material& material, const Matrix4D& transform, const Bounds& bounds, ShaderProgram* depthProgram = nullptr, unsigned int layer = 0);
+
+/**
+ * @brief Add the index range of a material that is drawn once for each instance of a range of an instance buffer (see
+ * drawBatchAddInstanced). The program has to be compiled with INSTANCED, the instance buffer is referenced until the
+ * last renderQueueSubmit of the frame.
+ *
+ * @param queue Render queue.
+ * @param program Shader program the item is drawn with.
+ * @param mesh Mesh the material belongs to.
+ * @param material Material with index range.
+ * @param transform Model matrix, applied before the instance matrix.
+ * @param instances Instance buffer.
+ * @param firstInstance Index of the first instance.
+ * @param instanceCount Number of instances.
+ * @param bounds World space bounds around the material range of all instances.
+ * @param depthProgram Shader program of depth-only submits, nullptr to leave the item out of them.
+ * @param layer Items are sorted by layer before anything else (0 .. 15).
+ */
+void renderQueuePushInstanced(RenderQueue& queue, ShaderProgram& program, const Mesh& mesh, const Material& material, const Matrix4D& transform, InstanceBuffer& instances, unsigned int firstInstance, unsigned int instanceCount, const Bounds& bounds, ShaderProgram* depthProgram = nullptr, unsigned int layer = 0);
+
+/**
+ * @brief Add geometry that the vertex shader generates from gl_VertexID and gl_InstanceID (see drawBatchSubmitArrays),
+ * the index range of the material is the vertex range. Mesh and material are referenced until the last
+ * renderQueueSubmit of the frame.
+ *
+ * @param queue Render queue.
+ * @param program Shader program the item is drawn with.
+ * @param mesh Mesh with the (empty) vertex array, position offset and scale.
+ * @param material Material with vertex range.
+ * @param mode Primitive type.
+ * @param instanceCount Number of instances.
+ * @param bounds World space bounds of the generated geometry.
+ * @param depthProgram Shader program of depth-only submits, nullptr to leave the item out of them.
+ * @param layer Items are sorted by layer before anything else (0 .. 15).
+ */
+void renderQueuePushArrays(RenderQueue& queue, ShaderProgram& program, const Mesh& mesh, const Material& material, GLenum mode, unsigned int instanceCount, const Bounds& bounds, ShaderProgram* depthProgram = nullptr, unsigned int layer = 0);
+
+/**
+ * @brief Cull all items against the frustum (bounding spheres four at a time, then the boxes of the remaining items),
+ * sort the visible ones by key (layer, program, material, VAO, front to back) and draw them. Items with the same program are
+ * submitted as one draw batch, so the program changes once per program and the VAO once per arena page. Uniforms that
+ * are shared by all items of a program (e.g. time) have to be set before. Culling and sorting is done once per frame,
+ * the queue can be submitted again (e.g. a depth-only pass first and the shading pass after it).
+ *
+ * @param queue Render queue.
+ * @param depthOnly Draw the items that have a depth program with it and the position-only VAOs of their meshes.
+ */
+void renderQueueSubmit(RenderQueue& queue, bool depthOnly = false);
@@ -1,9 +1,19 @@
 #include "shader.h"
 
+#include "file.h"
+#include "glstate.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 namespace detail
 {
@@ -57,10 +67,237 @@ namespace detail
             throw std::runtime_error((std::string("[Shader] ERROR link shaderprogram: \n") + programLog));
         }
     }
+
+    std::string binaryDirectory = "shadercache";
+
+    constexpr char binaryMagic[8] = {'M', 'Y', 'G', 'L', 'P', 'R', 'G', '\0'};
+
+    /* path of the cached binary for a pair of sources, empty if the cache is disabled or not supported */
+    std::string binaryPath(const std::string& vertexSource, const std::string& fragmentSource, std::uint64_t& key)
+    {
+        if(binaryDirectory.empty() || !GLAD_GL_ARB_get_program_binary)
+        {
+            return {};
+        }
+
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if(formats <= 0)
+        {
+            return {};
+        }
+
+        /* a driver update invalidates all binaries */
+        std::string text;
+        for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            text += reinterpret_cast<const char*>(glGetString(name));
+            text += '\n';
+        }
+        text += vertexSource;
+        text += '\0';
+        text += fragmentSource;
+        key = hashBytes(text.data(), text.size());
+
+        std::ostringstream path;
+        path << binaryDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+        return path.str();
+    }
+
+    bool loadBinary(GLuint handle, const std::string& path, std::uint64_t key)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file.is_open())
+        {
+            return false;
+        }
+
+        char magic[8] = {};
+        std::uint64_t storedKey = 0;
+        std::uint32_t format = 0, length = 0;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+        file.read(reinterpret_cast<char*>(&format), sizeof(format));
+        file.read(reinterpret_cast<char*>(&length), sizeof(length));
+        if(!file || std::memcmp(magic, binaryMagic, sizeof(magic)) != 0 || storedKey != key)
+        {
+            return false;
+        }
+
+        std::vector<char> binary(length);
+        file.read(binary.data(), length);
+        if(!file)
+        {
+            return false;
+        }
+
+        glProgramBinary(handle, format, binary.data(), static_cast<GLsizei>(length));
+
+        /* a rejected binary fails like a link error (some drivers also raise GL_INVALID_ENUM for unknown formats) */
+        while(glGetError() != GL_NO_ERROR) {}
+
+        GLint result = GL_FALSE;
+        glGetProgramiv(handle, GL_LINK_STATUS, &result);
+        return result == GL_TRUE;
+    }
+
+    /* failing to write the binary is not an error, the program is just compiled again next time */
+    void saveBinary(GLuint handle, const std::string& path, std::uint64_t key)
+    {
+        GLint length = 0;
+        glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+        {
+            return;
+        }
+
+        std::vector<char> binary(static_cast<std::size_t>(length));
+        GLenum format = 0;
+        glGetProgramBinary(handle, length, nullptr, &format, binary.data());
+
+        try
+        {
+            std::filesystem::create_directories(binaryDirectory);
+
+            /* write to a temporary file first, so a crash never leaves a half written binary behind */
+            std::string tmpPath = path + ".tmp";
+            {
+                std::uint32_t format32 = format, length32 = static_cast<std::uint32_t>(length);
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                file.write(binaryMagic, sizeof(binaryMagic));
+                file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+                file.write(reinterpret_cast<const char*>(&format32), sizeof(format32));
+                file.write(reinterpret_cast<const char*>(&length32), sizeof(length32));
+                file.write(binary.data(), length);
+                if(!file)
+                {
+                    throw std::runtime_error("write failed");
+                }
+            }
+
+            std::filesystem::rename(tmpPath, path);
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << "[Shader] Couldn't write program binary at " << path << " (" << e.what() << ")" << std::endl;
+        }
+    }
+
+    /* read the locations of all active uniforms into the table of the program */
+    void reflect(ShaderProgram& program)
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::string name;
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            name.resize(static_cast<std::size_t>(maxLength));
+            glGetActiveUniform(program.id, static_cast<GLuint>(i), maxLength, &length, &size, &type, &name[0]);
+            name.resize(static_cast<std::size_t>(length));
+
+            /* members of uniform blocks have no location */
+            GLint location = glGetUniformLocation(program.id, name.c_str());
+            if(location < 0)
+            {
+                continue;
+            }
+
+            /* arrays of basic types are reported once as "name[0]" */
+            if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                program.uniforms[base] = location;
+                for(GLint element = 0; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    program.uniforms[elementName] = glGetUniformLocation(program.id, elementName.c_str());
+                }
+            }
+            else
+            {
+                program.uniforms[name] = location;
+            }
+        }
+    }
+}
+
+namespace detail
+{
+    /* insert the defines directly after the #version line, #line keeps the line numbers of compile errors intact */
+    std::string injectDefines(const std::string& source, const std::vector<std::string>& defines)
+    {
+        if(defines.empty())
+        {
+            return source;
+        }
+
+        std::size_t insert = 0;
+        std::size_t version = source.find("#version");
+        if(version != std::string::npos)
+        {
+            std::size_t end = source.find('\n', version);
+            insert = end == std::string::npos ? source.size() : end + 1;
+        }
+        auto line = std::count(source.begin(), source.begin() + insert, '\n') + 1;
+
+        std::string block;
+        for(const auto& define : defines)
+        {
+            block += "#define " + define + "\n";
+        }
+        block += "#line " + std::to_string(line) + "\n";
+
+        std::string result = source;
+        if(insert == source.size() && (source.empty() || source.back() != '\n'))
+        {
+            block.insert(block.begin(), '\n');
+        }
+        return result.insert(insert, block);
+    }
+
+    std::string readShader(const std::string& path, const std::string& stage)
+    {
+        std::ifstream file(path);
+        if(!file.is_open())
+        {
+            std::cerr << "[Shader] Couldn't open " << stage << " shader file at " << path << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error("[Shader] Couldn't open " + stage + " shader file at " + path);
+        }
+
+        std::stringstream sourceBuffer;
+        sourceBuffer << file.rdbuf();
+        return sourceBuffer.str();
+    }
 }
 
-ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &fragmentSource)
+ShaderProgram shaderCreate(const std::string &vertexShader, const std::string &fragmentShader, const std::vector<std::string> &defines)
 {
+    PROFILE_ZONE("shaderCreate");
+
+    std::string vertexSource = detail::injectDefines(vertexShader, defines);
+    std::string fragmentSource = detail::injectDefines(fragmentShader, defines);
+
+    std::uint64_t key = 0;
+    std::string binaryPath = detail::binaryPath(vertexSource, fragmentSource, key);
+
+    /* fast path: a program linked earlier from the same sources, no shader objects are needed */
+    if(!binaryPath.empty())
+    {
+        ShaderProgram program{glCreateProgram()};
+        if(detail::loadBinary(program.id, binaryPath, key))
+        {
+            detail::reflect(program);
+            return program;
+        }
+        glDeleteProgram(program.id);
+    }
+
     ShaderProgram program{glCreateProgram(), glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER)};
 
     if(!program._vertexID || !program._fragmentID || !program.id)
@@ -76,46 +313,87 @@ ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &f
     detail::compile(program._fragmentID, fragmentSource.c_str(), fragmentSource.size());
     glAttachShader(program.id, program._fragmentID);
 
+    if(!binaryPath.empty())
+    {
+        glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     detail::link(program.id);
+    detail::reflect(program);
+
+    if(!binaryPath.empty())
+    {
+        detail::saveBinary(program.id, binaryPath, key);
+    }
 
     return program;
 }
 
-ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath)
+ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath, const std::vector<std::string> &defines)
 {
-    std::ifstream vertexFile(vertexPath);
-    std::ifstream fragmentFile(fragmentPath);
+    return shaderCreate(detail::readShader(vertexPath, "vertex"), detail::readShader(fragmentPath, "fragment"), defines);
+}
 
-    if(!vertexFile.is_open())
+ShaderVariants shaderVariantsLoad(const std::string &vertexPath, const std::string &fragmentPath)
+{
+    ShaderVariants variants;
+    variants.vertexSource = detail::readShader(vertexPath, "vertex");
+    variants.fragmentSource = detail::readShader(fragmentPath, "fragment");
+    return variants;
+}
+
+ShaderProgram& shaderVariant(ShaderVariants &variants, const std::vector<std::string> &defines)
+{
+    auto it = variants.programs.find(defines);
+    if(it != variants.programs.end())
     {
-        std::cerr << "[Shader] Couldn't open vertex shader file at " << std::endl;
-        std::cerr.flush();
-        throw std::runtime_error("[Shader] Couldn't open vertex shader file at " + vertexPath);
+        return it->second;
     }
 
-    if(!fragmentFile.is_open())
+    ShaderProgram program = shaderCreate(variants.vertexSource, variants.fragmentSource, defines);
+    for(const auto& [name, binding] : variants.blockBindings)
     {
-        std::cerr << "[Shader] Couldn't open fragment shader file at " << std::endl;
-        std::cerr.flush();
-        throw std::runtime_error("[Shader] Couldn't open fragment shader file at " + fragmentPath);
+        shaderUniformBlock(program, name, binding);
     }
 
-    std::stringstream vertexSourceBuffer;
-    vertexSourceBuffer << vertexFile.rdbuf();
+    return variants.programs.emplace(defines, std::move(program)).first->second;
+}
 
-    std::stringstream fragmentSourceBuffer;
-    fragmentSourceBuffer << fragmentFile.rdbuf();
+void shaderVariantsUniformBlock(ShaderVariants &variants, const std::string &name, GLuint binding)
+{
+    variants.blockBindings.emplace_back(name, binding);
+    for(auto& [defines, program] : variants.programs)
+    {
+        shaderUniformBlock(program, name, binding);
+    }
+}
 
-    return shaderCreate(vertexSourceBuffer.str(), fragmentSourceBuffer.str());
+void shaderVariantsDelete(ShaderVariants &variants)
+{
+    for(const auto& [defines, program] : variants.programs)
+    {
+        shaderDelete(program);
+    }
+    variants.programs.clear();
+}
+
+void shaderCacheDirectory(const std::string &directory)
+{
+    detail::binaryDirectory = directory;
 }
 
 void shaderDelete(const ShaderProgram &program)
 {
-    glDetachShader(program.id, program._vertexID);
-    glDetachShader(program.id, program._fragmentID);
-    glDeleteShader(program._vertexID);
-    glDeleteShader(program._fragmentID);
+    /* programs loaded from a binary have no shader objects */
+    if(program._vertexID != 0)
+    {
+        glDetachShader(program.id, program._vertexID);
+        glDetachShader(program.id, program._fragmentID);
+        glDeleteShader(program._vertexID);
+        glDeleteShader(program._fragmentID);
+    }
 
+    stateForgetProgram(program.id);
     glDeleteProgram(program.id);
 }
 
@@ -123,55 +401,119 @@ void shaderDelete(const ShaderProgram &program)
 namespace detail
 {
 
-GLint uniform_index(ShaderProgram &shader, const std::string &name)
+GLint uniform_index(const ShaderProgram &shader, const std::string &name)
 {
-    GLint index = glGetUniformLocation(shader.id, name.c_str());
-    if(index < 0)
+    auto it = shader.uniforms.find(name);
+    if(it == shader.uniforms.end())
     {
         std::cerr << "[Shader] Couldn't set value for uniform " << name << std::endl;
         std::cerr.flush();
         throw std::runtime_error("[Shader] Couldn't set value for uniform " + name);
     }
 
-    return index;
+    return it->second;
+}
+
 }
 
+void shaderUniformBlock(ShaderProgram &shader, const std::string &name, GLuint binding)
+{
+    GLuint index = glGetUniformBlockIndex(shader.id, name.c_str());
+    if(index == GL_INVALID_INDEX)
+    {
+        std::cerr << "[Shader] Couldn't find uniform block " << name << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Shader] Couldn't find uniform block " + name);
+    }
+
+    glUniformBlockBinding(shader.id, index, binding);
+}
+
+UniformHandle shaderUniformHandle(const ShaderProgram &shader, const std::string &name)
+{
+    return UniformHandle{detail::uniform_index(shader, name)};
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Matrix4D& value)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniformMatrix4fv(index, 1, GL_FALSE, value.ptr());
+    shaderUniform(UniformHandle{detail::uniform_index(shader, name)}, value);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, int value)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform1i(index, value);
+    shaderUniform(UniformHandle{detail::uniform_index(shader, name)}, value);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector2D& vec)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform2f(index, vec.x, vec.y);
+    shaderUniform(UniformHandle{detail::uniform_index(shader, name)}, vec);
 }
 
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector3D& vec)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform3f(index, vec.x, vec.y, vec.z);
+    shaderUniform(UniformHandle{detail::uniform_index(shader, name)}, vec);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector4D& vec)
 {
-    GLint index = detail::uniform_index(shader, name);
-
-    glUniform4f(index, vec.x, vec.y, vec.z, vec.w);
+    shaderUniform(UniformHandle{detail::uniform_index(shader, name)}, vec);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, float value)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform1f(index, value);
+    shaderUniform(UniformHandle{detail::uniform_index(shader, name)}, value);
+}
+
+void shaderUniform(ShaderProgram &shader, const std::string &name, const WaveParams& value)
+{
+    auto it = shader.uniforms.find(name);
+    if (it != shader.uniforms.end())
+    {
+        shaderUniform(UniformHandle{it->second}, Vector4D(value.amplitude, value.phi, value.omega, 0.0)); // Assuming you're using vec4 for WaveParams
+    }
+    else
+    {
+        std::cout << "Warning: Uniform " << name << " not found!" << std::endl;
+    }
+}
+
+/* uniforms are only uploaded if the value differs from the last one written to the location (see glstate.h) */
+void shaderUniform(UniformHandle handle, const Matrix4D& value)
+{
+    if(stateUniform(handle.location, value.ptr(), 16 * sizeof(float)))
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, value.ptr());
+}
+
+void shaderUniform(UniformHandle handle, const Vector2D& vec)
+{
+    float data[2] = {vec.x, vec.y};
+    if(stateUniform(handle.location, data, sizeof(data)))
+        glUniform2fv(handle.location, 1, data);
+}
+
+void shaderUniform(UniformHandle handle, const Vector3D& vec)
+{
+    float data[3] = {vec.x, vec.y, vec.z};
+    if(stateUniform(handle.location, data, sizeof(data)))
+        glUniform3fv(handle.location, 1, data);
+}
+
+void shaderUniform(UniformHandle handle, const Vector4D& vec)
+{
+    float data[4] = {vec.x, vec.y, vec.z, vec.w};
+    if(stateUniform(handle.location, data, sizeof(data)))
+        glUniform4fv(handle.location, 1, data);
+}
+
+void shaderUniform(UniformHandle handle, int value)
+{
+    if(stateUniform(handle.location, &value, sizeof(value)))
+        glUniform1i(handle.location, value);
+}
+
+void shaderUniform(UniformHandle handle, float value)
+{
+    if(stateUniform(handle.location, &value, sizeof(value)))
+        glUniform1f(handle.location, value);
 }
@@ -2,6 +2,10 @@
 
 
 #include <iostream>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "base.h"
 #include "water.h"
 
@@ -10,6 +14,27 @@ struct ShaderProgram
     GLuint id = 0;
     GLuint _vertexID = 0;
     GLuint _fragmentID = 0;
+
+    /* locations of all active uniforms, read once after linking (array elements are listed as "name[i]" and "name") */
+    std::unordered_map<std::string, GLint> uniforms;
+};
+
+/* location of a uniform, looked up once with shaderUniformHandle */
+struct UniformHandle
+{
+    GLint location = -1;
+};
+
+/* permutations of one pair of shader sources, specialized with #defines and compiled on first use */
+struct ShaderVariants
+{
+    std::string vertexSource;
+    std::string fragmentSource;
+
+    /* uniform block bindings, applied to every variant when it is compiled */
+    std::vector<std::pair<std::string, GLuint>> blockBindings;
+
+    std::map<std::vector<std::string>, ShaderProgram> programs;
 };
 
 /**
@@ -17,20 +42,69 @@ struct ShaderProgram
  *
  * @param vertexPath Path to vertex shader file.
  * @param fragmentPath Path to fragment shader file.
+ * @param defines Defines injected into both shaders (see shaderCreate).
  *
  * @return Shader program.
  */
-ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragmentPath);
+ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = {});
 
 /**
- * @brief Function to compile and link vertex and fragement source strings to create shader program.
+ * @brief Function to compile and link vertex and fragement source strings to create shader program. If the program
+ * binary cache is enabled, a binary linked earlier from the same sources by the same driver is loaded instead.
  *
  * @param vertexSource Source string holding vertex shader code.
  * @param fragmentSource Source string holding fragment shader code.
+ * @param defines Defines like "SPOT_LIGHTS 2" or "NIGHT", each becomes a "#define" line after the #version line.
  *
  * @return Shader program.
  */
-ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& fragmentSource);
+ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& fragmentSource, const std::vector<std::string>& defines = {});
+
+/**
+ * @brief Load the sources of a shader with variants. No program is compiled until it is requested with shaderVariant.
+ *
+ * @param vertexPath Path to vertex shader file.
+ * @param fragmentPath Path to fragment shader file.
+ *
+ * @return Shader variants without compiled programs.
+ */
+ShaderVariants shaderVariantsLoad(const std::string& vertexPath, const std::string& fragmentPath);
+
+/**
+ * @brief Get the program for a set of defines, compiling (or loading it from the program binary cache) on first use.
+ * The same defines in a different order are a different variant.
+ *
+ * @param variants Shader variants.
+ * @param defines Defines injected into both shaders.
+ *
+ * @return Shader program of the variant, stays valid until shaderVariantsDelete.
+ */
+ShaderProgram& shaderVariant(ShaderVariants& variants, const std::vector<std::string>& defines);
+
+/**
+ * @brief Connect a uniform block of all current and future variants to a uniform buffer binding point.
+ *
+ * @param variants Shader variants.
+ * @param name Name of the uniform block.
+ * @param binding Binding point of the uniform buffer.
+ */
+void shaderVariantsUniformBlock(ShaderVariants& variants, const std::string& name, GLuint binding);
+
+/**
+ * @brief Delete all compiled variants.
+ *
+ * @param variants Shader variants.
+ */
+void shaderVariantsDelete(ShaderVariants& variants);
+
+/**
+ * @brief Set the directory for cached program binaries (glGetProgramBinary). Binaries are keyed by a hash of the
+ * complete shader sources (including injected defines) and the vendor, renderer and version strings of the driver.
+ * Binaries the driver rejects are replaced by compiling from source. The default is "shadercache".
+ *
+ * @param directory Cache directory, an empty string disables the cache.
+ */
+void shaderCacheDirectory(const std::string& directory);
 
 /**
  * @brief Cleanup and delete all shaders of a shader program and the program itself. Has to be called for each shader program after it is not used anymore.
@@ -39,6 +113,25 @@ ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& f
  */
 void shaderDelete(const ShaderProgram& program);
 
+/**
+ * @brief Connect a uniform block of the shader program to a uniform buffer binding point (see uniformbuffer.h).
+ *
+ * @param shader Shader program.
+ * @param name Name of the uniform block.
+ * @param binding Binding point of the uniform buffer.
+ */
+void shaderUniformBlock(ShaderProgram& shader, const std::string& name, GLuint binding);
+
+/**
+ * @brief Look up the location of an active uniform in the table of the shader program.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name.
+ *
+ * @return Handle that can be used with the handle based shaderUniform overloads.
+ */
+UniformHandle shaderUniformHandle(const ShaderProgram& shader, const std::string& name);
+
 /**
  * @brief Function to set uniform in shader program.
  *
@@ -93,15 +186,25 @@ void shaderUniform(ShaderProgram& shader, const std::string& name, int value);
  */
 void shaderUniform(ShaderProgram& shader, const std::string& name, float value);
 
-inline void shaderUniform(ShaderProgram& shader, const std::string& name, const WaveParams& value)
-{
-    int location = glGetUniformLocation(shader.id, name.c_str());
-    if (location != -1)
-    {
-        glUniform4f(location, value.amplitude, value.phi, value.omega, 0.0); // Assuming you're using vec4 for WaveParams
-    }
-    else
-    {
-        std::cout << "Warning: Uniform " << name << " not found!" << std::endl;
-    }
-}
+/**
+ * @brief Function to set uniform in shader program.
+ *
+ * @param shader Shader program.
+ * @param name Uniform naem.
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(ShaderProgram& shader, const std::string& name, const WaveParams& value);
+
+/**
+ * @brief Set uniforms by handle, without looking up the name. The shader program has to be in use. Like the name based
+ * overloads, nothing is uploaded if the location already holds the value (see glstate.h).
+ *
+ * @param handle Handle returned by shaderUniformHandle.
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(UniformHandle handle, const Matrix4D& value);
+void shaderUniform(UniformHandle handle, const Vector2D& vec);
+void shaderUniform(UniformHandle handle, const Vector3D& vec);
+void shaderUniform(UniformHandle handle, const Vector4D& vec);
+void shaderUniform(UniformHandle handle, int value);
+void shaderUniform(UniformHandle handle, float value);
@@ -1,5 +1,7 @@
 #include "texture.h"
 
+#include "glstate.h"
+
 #include <stdexcept>
 #include <iostream>
 
@@ -24,7 +26,7 @@ Texture textureLoad(const std::string &path)
     /* upload data */
     GLuint id = 0;
     glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_2D, id);
+    stateBindTexture(GL_TEXTURE_2D, id);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
     glCheckError();
 
@@ -35,7 +37,7 @@ Texture textureLoad(const std::string &path)
     glCheckError();
 
     stbi_image_free(data);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    stateBindTexture(GL_TEXTURE_2D, 0);
 
     return Texture{id, (unsigned int) width, (unsigned int) height};
 }
@@ -43,4 +45,5 @@ Texture textureLoad(const std::string &path)
 void textureDelete(const Texture &texture)
 {
     glDeleteTextures(1, &texture.id);
+    stateInvalidate();
 }
@@ -0,0 +1,96 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+namespace detail
+{
+
+void workerLoop(ThreadPool* pool)
+{
+    while(true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->wake.wait(lock, [pool]() { return pool->stop || !pool->jobs.empty(); });
+
+            if(pool->jobs.empty())
+            {
+                return;
+            }
+
+            job = std::move(pool->jobs.front());
+            pool->jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+}
+
+ThreadPool* threadPoolCreate(unsigned int threads)
+{
+    if(threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    ThreadPool* pool = new ThreadPool;
+    for(unsigned int i = 0; i < threads; i++)
+    {
+        pool->workers.emplace_back(detail::workerLoop, pool);
+    }
+
+    return pool;
+}
+
+void threadPoolDelete(ThreadPool* pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stop = true;
+    }
+    pool->wake.notify_all();
+
+    for(auto& worker : pool->workers)
+    {
+        worker.join();
+    }
+
+    delete pool;
+}
+
+ThreadPool* threadPoolShared()
+{
+    /* never deleted, worker threads are blocked in wait when the process exits */
+    static ThreadPool* pool = threadPoolCreate();
+    return pool;
+}
+
+void threadPoolPush(ThreadPool* pool, std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->jobs.push_back(std::move(job));
+    }
+    pool->wake.notify_one();
+}
+
+bool threadPoolRunOne(ThreadPool* pool)
+{
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if(pool->jobs.empty())
+        {
+            return false;
+        }
+
+        job = std::move(pool->jobs.front());
+        pool->jobs.pop_front();
+    }
+
+    job();
+    return true;
+}
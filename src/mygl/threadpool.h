@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPool
+{
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop = false;
+};
+
+/**
+ * @brief Create a thread pool with a fixed number of worker threads.
+ *
+ * @param threads Number of worker threads (0 uses the number of hardware threads).
+ *
+ * @return Thread pool, has to be deleted with threadPoolDelete.
+ */
+ThreadPool* threadPoolCreate(unsigned int threads = 0);
+
+/**
+ * @brief Finish all queued jobs, stop the worker threads and delete the pool.
+ *
+ * @param pool Thread pool to delete.
+ */
+void threadPoolDelete(ThreadPool* pool);
+
+/**
+ * @brief Process wide pool with one worker per hardware thread, created on first use.
+ *
+ * @return Shared thread pool.
+ */
+ThreadPool* threadPoolShared();
+
+/**
+ * @brief Queue a job without a result.
+ *
+ * @param pool Thread pool.
+ * @param job Job to run on one of the workers.
+ */
+void threadPoolPush(ThreadPool* pool, std::function<void()> job);
+
+/**
+ * @brief Run one queued job on the calling thread, if there is one.
+ *
+ * @param pool Thread pool.
+ *
+ * @return True if a job was run.
+ */
+bool threadPoolRunOne(ThreadPool* pool);
+
+/**
+ * @brief Queue a job and get a future for its result.
+ *
+ * @param pool Thread pool.
+ * @param job Callable to run on one of the workers.
+ *
+ * @return Future that receives the result (or exception) of the job.
+ */
+template<typename F>
+auto threadPoolSubmit(ThreadPool* pool, F&& job) -> std::future<decltype(job())>
+{
+    using R = decltype(job());
+
+    /* std::function needs a copyable callable, packaged_task is move only */
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(job));
+    std::future<R> result = task->get_future();
+    threadPoolPush(pool, [task]() { (*task)(); });
+
+    return result;
+}
+
+/**
+ * @brief Wait for a future of a job of this pool. While waiting, the calling thread helps with queued jobs, so jobs
+ * can safely wait for jobs they submitted themselves.
+ *
+ * @param pool Thread pool the job was submitted to.
+ * @param future Future to wait for.
+ */
+template<typename R>
+void threadPoolWait(ThreadPool* pool, const std::future<R>& future)
+{
+    while(future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        if(!threadPoolRunOne(pool))
+        {
+            future.wait_for(std::chrono::microseconds(100));
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#include "uniformbuffer.h"
+
+#include "glstate.h"
+
+UniformBuffer uniformBufferCreate(GLuint binding, std::size_t size)
+{
+    UniformBuffer buffer{0, binding, size};
+
+    glGenBuffers(1, &buffer.id);
+    stateBindBuffer(GL_UNIFORM_BUFFER, buffer.id);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    stateBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    stateBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer.id);
+    glCheckError();
+
+    return buffer;
+}
+
+void uniformBufferUpdate(const UniformBuffer &buffer, const void *data)
+{
+    /* orphan the old storage, draws of the previous frame may still read it */
+    stateBindBuffer(GL_UNIFORM_BUFFER, buffer.id);
+    glBufferData(GL_UNIFORM_BUFFER, buffer.size, nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, buffer.size, data);
+    glCheckError();
+}
+
+void uniformBufferDelete(const UniformBuffer &buffer)
+{
+    glDeleteBuffers(1, &buffer.id);
+    stateInvalidate();
+}
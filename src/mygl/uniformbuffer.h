@@ -0,0 +1,37 @@
+#pragma once
+
+#include "base.h"
+
+struct UniformBuffer
+{
+    GLuint id = 0;
+
+    /* binding point the buffer is attached to, programs connect their blocks with shaderUniformBlock */
+    GLuint binding = 0;
+    std::size_t size = 0;
+};
+
+/**
+ * @brief Create a uniform buffer object and attach it to a binding point.
+ *
+ * @param binding Uniform buffer binding point.
+ * @param size Size of the buffer in bytes (the std140 size of the block).
+ *
+ * @return Uniform buffer.
+ */
+UniformBuffer uniformBufferCreate(GLuint binding, std::size_t size);
+
+/**
+ * @brief Replace the whole content of a uniform buffer (done once per frame for per frame data).
+ *
+ * @param buffer Uniform buffer.
+ * @param data Pointer to buffer.size bytes in std140 layout.
+ */
+void uniformBufferUpdate(const UniformBuffer& buffer, const void* data);
+
+/**
+ * @brief Delete a uniform buffer. Has to be called for each uniform buffer after it is not used anymore.
+ *
+ * @param buffer Uniform buffer to delete.
+ */
+void uniformBufferDelete(const UniformBuffer& buffer);
@@ -1,5 +1,11 @@
 #version 330 core
 
+// Number of spot lights that are evaluated, injected per program variant (see shaderVariant). Variants compiled with
+// DAY evaluate no spot lights at all, they don't contribute visibly in daylight.
+#ifndef SPOT_LIGHTS
+#define SPOT_LIGHTS 4
+#endif
+
 struct Material
 {
     vec3 ambient;
@@ -18,7 +24,7 @@ struct spotLight{
     vec3 directLight;
     vec3 position;
     vec3 direction;
-    float cutoffAngle;
+    float cosCutoff;    // cosine of the cutoff angle, computed once per frame on the CPU
 };
 
 struct Surface{
@@ -32,67 +38,130 @@ struct Camera{
 
 in vec3 tNormal;
 in vec3 tFragPos;
+flat in int tDraw;
+#ifdef INSTANCED
+flat in vec4 tTint;
+#endif
 
 out vec4 FragColor;
 
-uniform Material uMaterial;
+// Per draw data (see batch.h), the material is stored in the first 3 texels of a draw
+uniform samplerBuffer uDrawData;
 uniform Surface uSurface;
-uniform Camera uCamera;
 
-// Light sources
-uniform dayLight uLightDayNight;
-uniform spotLight uSpotLights[4];
+// Camera and light sources, written once per frame into a uniform buffer (std140, has to match FrameData in assignment_2.cpp)
+layout(std140) uniform FrameData
+{
+    mat4 uView;
+    mat4 uProj;
+    Camera uCamera;
+    dayLight uLightDayNight;
+    spotLight uSpotLights[4];
+};
+
+#ifdef CLUSTERED
+// Clustered lights (see lightgrid.h): 3 texels per light (color + range, position + cosine of the cutoff, direction),
+// offset and count of the light indices of each cluster and the light indices of all clusters
+uniform samplerBuffer uLights;
+uniform usamplerBuffer uClusters;
+uniform usamplerBuffer uClusterLights;
+
+// Pixels to tiles (xy) and log view depth to slice (zw), clusters in x, y and z
+uniform vec4 uClusterScale;
+uniform vec3 uClusterSize;
+#endif
+
+// Diffuse and specular light of a spot light, without attenuation
+vec3 spotLightContribution(vec3 color, vec3 position, vec3 direction, float cosCutoff, Material material, vec3 surfaceNormal)
+{
+    vec3 lightDir = normalize(position - tFragPos);
+    // Cosine of the angle between the direction of the spotlight and the direction of the light to the fragment
+    float cosTheta = dot(-lightDir, direction);
+
+    // Check if the fragment is within the spotlight cone (cos is smaller for higher angles!)
+    if (cosTheta <= cosCutoff) {
+        return vec3(0.0);
+    }
+
+    vec3 diffuseLight =
+    material.diffuse
+    * color
+    * max(dot(surfaceNormal, lightDir),0.0);
+
+    vec3 viewDir = normalize(uCamera.position - tFragPos);
+    vec3 reflectDir = reflect(-lightDir, surfaceNormal);
+    float specularFactor = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    vec3 specularLight = material.specular * color * specularFactor;
+
+    return diffuseLight + specularLight;
+}
+
+float attenuation(float distance)
+{
+    return 1.0 / (1.0 + 0.2 * distance + 0.1 * distance * distance);
+}
 
 
 void main(void)
 {
     vec3 surfaceNormal = normalize(tNormal);
 
+    vec4 ambientShininess = texelFetch(uDrawData, 9 * tDraw);
+    Material material = Material(ambientShininess.xyz, texelFetch(uDrawData, 9 * tDraw + 1).xyz,
+                                  texelFetch(uDrawData, 9 * tDraw + 2).xyz, ambientShininess.w);
+
 
     // Sun/Moon
-    vec3 ambientLight = uMaterial.diffuse * uLightDayNight.ambientLight;
+    vec3 ambientLight = material.diffuse * uLightDayNight.ambientLight;
 
     vec3 diffuseLightDayNight =
-        uMaterial.diffuse
+        material.diffuse
         * uLightDayNight.directLight
         * max(dot(surfaceNormal, normalize(uLightDayNight.position)),0.0);
 
     vec3 specularLightDayNight =
-        uMaterial.specular
+        material.specular
         * uLightDayNight.directLight
-        * pow(max(dot(surfaceNormal, normalize(uCamera.position+uLightDayNight.position)),0.0),uMaterial.shininess);
+        * pow(max(dot(surfaceNormal, normalize(uCamera.position+uLightDayNight.position)),0.0),material.shininess);
 
     vec3 light = ambientLight + diffuseLightDayNight + specularLightDayNight;
 
 
-    // Point Lights
-    for (int i=0; i<4; i++){
-
-        vec3 lightDir = normalize(uSpotLights[i].position - tFragPos);
-        // Cosine of the angle between the direction of the spotlight and the direction of the light to the fragment
-        float cosTheta = dot(-lightDir, normalize(uSpotLights[i].direction));
+#if defined(DAY)
+    // Daylight, only the sun
+#elif defined(CLUSTERED)
+    // Only the lights whose range touches the cluster of the fragment
+    float viewDepth = -(uView * vec4(tFragPos, 1.0)).z;
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * uClusterScale.xy), int(log(max(viewDepth, 1e-6)) * uClusterScale.z + uClusterScale.w));
+    cluster = clamp(cluster, ivec3(0), ivec3(uClusterSize) - 1);
+    uvec2 range = texelFetch(uClusters, cluster.x + int(uClusterSize.x) * (cluster.y + int(uClusterSize.y) * cluster.z)).xy;
 
-        // Check if the fragment is within the spotlight cone (cos is smaller for higher angles!)
-        if (cosTheta > cos(uSpotLights[i].cutoffAngle)) {
+    for (uint i = 0u; i < range.y; i++){
+        int index = 3 * int(texelFetch(uClusterLights, int(range.x + i)).x);
+        vec4 colorRange = texelFetch(uLights, index);
+        vec4 positionCutoff = texelFetch(uLights, index + 1);
+        vec3 direction = texelFetch(uLights, index + 2).xyz;
 
-            vec3 diffuseLight =
-            uMaterial.diffuse
-            * uSpotLights[i].directLight
-            * max(dot(surfaceNormal, normalize(uSpotLights[i].position-tFragPos)),0.0);
-
-            vec3 viewDir = normalize(uCamera.position - tFragPos);
-            vec3 reflectDir = reflect(-lightDir, surfaceNormal);
-            float specularFactor = pow(max(dot(viewDir, reflectDir), 0.0), uMaterial.shininess);
-            vec3 specularLight = uMaterial.specular * uSpotLights[i].directLight * specularFactor;
-
-            float distance = length(tFragPos - uSpotLights[i].position);
-            float attenuation = 1.0 / (1.0 + 0.2 * distance + 0.1 * distance * distance);
-
-            light += (diffuseLight+specularLight)*attenuation;
-        }
+        // The attenuation is faded out towards the range, so lights end smoothly at the cluster borders
+        float distance = length(tFragPos - positionCutoff.xyz);
+        float window = clamp(1.0 - pow(distance / colorRange.w, 4.0), 0.0, 1.0);
 
+        light += spotLightContribution(colorRange.rgb, positionCutoff.xyz, direction, positionCutoff.w, material, surfaceNormal)
+               * attenuation(distance) * window * window;
     }
+#else
+    // Point Lights (only the active ones, they are packed to the front of uSpotLights)
+    for (int i=0; i<SPOT_LIGHTS; i++){
+        float distance = length(tFragPos - uSpotLights[i].position);
+        light += spotLightContribution(uSpotLights[i].directLight, uSpotLights[i].position, normalize(uSpotLights[i].direction),
+                                       uSpotLights[i].cosCutoff, material, surfaceNormal) * attenuation(distance);
+    }
+#endif
+
 
+#ifdef INSTANCED
+    light *= tTint.rgb;
+#endif
 
     FragColor = vec4(light, 1.0);
 }
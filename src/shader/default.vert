@@ -1,18 +1,69 @@
 #version 330
+#extension GL_ARB_shader_draw_parameters : enable
+
+struct dayLight{
+    vec3 directLight;
+    vec3 ambientLight;
+    vec3 position;
+};
+
+struct spotLight{
+    vec3 directLight;
+    vec3 position;
+    vec3 direction;
+    float cosCutoff;    // cosine of the cutoff angle, computed once per frame on the CPU
+};
+
+struct Camera{
+    vec3 position;
+};
+
+// Per frame data, written once per frame into a uniform buffer (std140, has to match FrameData in assignment_2.cpp)
+layout(std140) uniform FrameData
+{
+    mat4 uView;
+    mat4 uProj;
+    Camera uCamera;
+    dayLight uLightDayNight;
+    spotLight uSpotLights[4];
+};
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
 uniform float uTime;  // Time variable
 
+// Per draw data (see batch.h), 9 texels per draw: ambient + shininess, diffuse, specular, position offset + first
+// instance, position scale and the columns of the model matrix
+uniform samplerBuffer uDrawData;
+uniform int uDrawOffset;
+
+#ifdef INSTANCED
+// Per instance data (see batch.h), 5 texels per instance: the columns of the instance matrix and a tint color
+uniform samplerBuffer uInstanceData;
+#endif
+
+#ifdef CLIPMAP
+// Distance from the camera (in cells of the draw) where vertices start and finish morphing to the next coarser level
+uniform vec2 uGridMorph;
+#endif
+
 uniform vec4 wave1Params;
 uniform vec4 wave2Params;
 uniform vec4 wave3Params;
 
-in vec3 aPosition;  // Original vertex position
+#ifndef GRID
+in vec3 aPosition;  // Original vertex position (possibly quantized)
+#endif
 
 out vec3 tFragPos;  // Output for fragment shader
 out vec3 tNormal;   // Output for fragment shader
+flat out int tDraw; // Index of the draw for the per draw data
+
+// The depth pre-pass draws with depth.frag and the shading pass tests GL_EQUAL against its depth, both programs have
+// to compute exactly the same positions
+invariant gl_Position;
+
+#ifdef INSTANCED
+flat out vec4 tTint; // Tint of the instance
+#endif
 
 // Function to calculate the height of the water surface at a given point
 float calculateWaterHeight(vec3 position, float time, vec4 waveParams)
@@ -58,29 +109,72 @@ mat4 calculateRotationMatrix(vec3 position, float time, vec4 waveParams)
     return rotationMatrix;
 }
 
+#ifdef GRID
+// Grid without vertex data (see Clipmap in grid.h): every instance is one row of cells drawn as a triangle strip, even
+// vertices are on the near and odd vertices on the far edge of the row. The result is in cells, offset and scale of the
+// draw map it to object space.
+vec3 gridPosition()
+{
+    return vec3(float(gl_VertexID >> 1), 0.0, float(gl_InstanceID + (gl_VertexID & 1)));
+}
+#endif
+
 void main()
 {
+#ifdef GL_ARB_shader_draw_parameters
+    tDraw = uDrawOffset + gl_DrawIDARB;
+#else
+    tDraw = uDrawOffset;
+#endif
+
+    // Quantized positions (see eVertexFormat) are decoded with offset + scale * aPosition
+#ifdef GRID
+    vec3 vertex = gridPosition();
+#else
+    vec3 vertex = aPosition;
+#endif
+    vec3 position = texelFetch(uDrawData, 9 * tDraw + 3).xyz + texelFetch(uDrawData, 9 * tDraw + 4).xyz * vertex;
+
+#ifdef CLIPMAP
+    // Odd vertices near the border of a level slide onto the grid of the next coarser level (see clipmapMorph), so the
+    // border of the level matches the inner border of the level around it
+    float cell = texelFetch(uDrawData, 9 * tDraw + 4).x;
+    vec2 fromCamera = abs(position.xz - uCamera.position.xz) / cell;
+    float morph = clamp((max(fromCamera.x, fromCamera.y) - uGridMorph.x) / (uGridMorph.y - uGridMorph.x), 0.0, 1.0);
+    position.xz -= mod(floor(position.xz / cell + 0.5), 2.0) * cell * morph;
+#endif
+    mat4 model = mat4(texelFetch(uDrawData, 9 * tDraw + 5), texelFetch(uDrawData, 9 * tDraw + 6),
+                      texelFetch(uDrawData, 9 * tDraw + 7), texelFetch(uDrawData, 9 * tDraw + 8));
+
+#ifdef INSTANCED
+    // The instance matrix places the whole model (e.g. one boat of a fleet)
+    int instance = 5 * (int(texelFetch(uDrawData, 9 * tDraw + 3).w) + gl_InstanceID);
+    model = mat4(texelFetch(uInstanceData, instance), texelFetch(uInstanceData, instance + 1),
+                 texelFetch(uInstanceData, instance + 2), texelFetch(uInstanceData, instance + 3)) * model;
+    tTint = texelFetch(uInstanceData, instance + 4);
+#endif
+
     // Compute the height of the water surface at the current point
-    float height1 = calculateWaterHeight(aPosition, uTime, wave1Params);
-    float height2 = calculateWaterHeight(aPosition, uTime, wave2Params);
-    float height3 = calculateWaterHeight(aPosition, uTime, wave3Params);
+    float height1 = calculateWaterHeight(position, uTime, wave1Params);
+    float height2 = calculateWaterHeight(position, uTime, wave2Params);
+    float height3 = calculateWaterHeight(position, uTime, wave3Params);
 
     // Sum the heights of all waves
     float totalHeight = height1 + height2 + height3;
 
     // Compute the rotation matrix
-    mat4 rotationMatrix = calculateRotationMatrix(aPosition, uTime, wave1Params);
+    mat4 rotationMatrix = calculateRotationMatrix(position, uTime, wave1Params);
 
     // Compute the new position of the vertex with displacement
-    vec3 displacedPosition = aPosition + vec3(0.0, totalHeight, 0.0);
+    vec3 displacedPosition = position + vec3(0.0, totalHeight, 0.0);
 
     // Compute the new normal vector
     vec3 newNormal = normalize((rotationMatrix * vec4(0.0, 1.0, 0.0, 0.0)).xyz);
 
     // Compute the new position and normal vector
-    tFragPos = vec3(uModel * vec4(displacedPosition, 1.0));
-    tNormal = vec3(uModel * vec4(newNormal, 0.0));
+    tFragPos = vec3(model * vec4(displacedPosition, 1.0));
+    tNormal = vec3(model * vec4(newNormal, 0.0));
 
     // Compute the final position of the vertex
-    gl_Position = uProj * uView * uModel * vec4(displacedPosition, 1.0);
+    gl_Position = uProj * uView * model * vec4(displacedPosition, 1.0);
 }
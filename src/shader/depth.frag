@@ -0,0 +1,6 @@
+#version 330 core
+
+// Fragment shader of the depth pre-pass: the color writes are masked, only the depth of the vertex shader is written
+void main()
+{
+}